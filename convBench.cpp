@@ -0,0 +1,97 @@
+#include "ROOT/RHist.hxx"
+#include "TH3.h"
+
+#include "histConv.hpp.dcl"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+
+// Typing this gets old quickly
+namespace RExp = ROOT::Experimental;
+
+// Benchmark tuning knobs
+constexpr size_t MIN_BINS_PER_AXIS = 8;
+constexpr size_t MAX_BINS_PER_AXIS = 256;  // 256^3 bins = 16M bins
+constexpr size_t NUM_FILLS = 1024 * 1024;
+constexpr size_t MIN_BINS_PER_RUN = 64 * 1024 * 1024;  // Keeps timings stable
+constexpr std::pair<double, double> AXIS_RANGE = {0., 1.};
+
+// We study 3D hists with floating-point bins and bin uncertainties, which are
+// the largest (and thus most parallelization-friendly) conversion workload.
+using Hist3D = RExp::RHist<3, double>;
+
+
+// Benchmark the in-place refresh of a ROOT 6 histogram from a ROOT 7 one
+//
+// Refreshes are used instead of full conversions so that the timings focus
+// on bin data transfer, which is the part of conversion that gets split
+// across threads, rather than on the allocation of the ROOT 6 histogram.
+//
+// Returns the average time spent per bin, in nanoseconds.
+//
+float bench(const Hist3D& src, TH3D& dest, unsigned num_threads) {
+    using namespace std::chrono;
+
+    HistConversionCache cache;
+    Root6ConversionOptions options;
+    options.cache = &cache;
+    options.num_threads = num_threads;
+
+    // Warm up the conversion plan cache and the output histogram
+    into_root6_hist(src, dest, options);
+
+    // Repeat the refresh enough times to get a stable timing
+    const size_t num_bins = dest.GetNcells();
+    const size_t num_runs = std::max(MIN_BINS_PER_RUN / num_bins, size_t(1));
+    auto start = high_resolution_clock::now();
+    for ( size_t i = 0; i < num_runs; ++i ) {
+        into_root6_hist(src, dest, options);
+    }
+    auto end = high_resolution_clock::now();
+    return duration_cast<duration<float, std::nano>>(end - start).count()
+               / (num_runs * num_bins);
+}
+
+
+int main() {
+    std::mt19937 rng;
+    std::uniform_real_distribution<double> coord_dist{AXIS_RANGE.first,
+                                                      AXIS_RANGE.second};
+    const auto max_threads = std::thread::hardware_concurrency();
+
+    for ( size_t num_bins = MIN_BINS_PER_AXIS;
+          num_bins <= MAX_BINS_PER_AXIS;
+          num_bins *= 2 ) {
+        std::cout << "=== " << num_bins << "^3 BINS ===" << std::endl;
+
+        // Build and fill the input histogram
+        RExp::RAxisConfig axis{int(num_bins),
+                               AXIS_RANGE.first,
+                               AXIS_RANGE.second};
+        Hist3D src{{axis, axis, axis}};
+        for ( size_t i = 0; i < NUM_FILLS; ++i ) {
+            src.Fill({coord_dist(rng), coord_dist(rng), coord_dist(rng)});
+        }
+        auto dest = into_root6_hist(src, "convBench");
+
+        // Measure conversion performance at increasing thread counts. The
+        // break-even point is where multi-threaded timings drop below the
+        // sequential one.
+        const float seq_time = bench(src, dest, 1);
+        std::cout << "* 1 thread -> " << seq_time << " ns/bin" << std::endl;
+        for ( unsigned num_threads = 2;
+              num_threads <= max_threads;
+              num_threads *= 2 ) {
+            const float par_time = bench(src, dest, num_threads);
+            std::cout << "* " << num_threads << " threads -> "
+                      << par_time << " ns/bin (speedup: "
+                      << seq_time / par_time << ")" << std::endl;
+        }
+    }
+    return 0;
+}
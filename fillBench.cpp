@@ -2,22 +2,80 @@
 #include "ROOT/RHistConcurrentFill.hxx"
 #include "ROOT/RHistBufferedFill.hxx"
 
+#include "RVersion.h"
+
+#include "histFill.hpp"
+
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <exception>
+#include <fstream>
 #include <functional>
+#include <iomanip>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <random>
+#include <string>
 #include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include <sys/utsname.h>
 
 
 // Typing this gets old quickly
 namespace RExp = ROOT::Experimental;
 
-// Benchmark tuning knobs
-constexpr size_t NUM_BINS = 1000;  // Will tune this when testing atomic bins
-constexpr size_t NUM_ITERS = 512 * 1024 * 1024;  // Should be a power of 2
-constexpr std::pair<float, float> AXIS_RANGE = {0., 1.};
+// Benchmark tuning knobs, which can be changed on the command line (see
+// print_usage() for the meaning of each)
+struct BenchConfig {
+    std::vector<std::string> sections = {"scalar", "batch", "adaptive",
+                                         "aggregation", "columnar", "cache",
+                                         "scaling", "atomic"};
+    std::string filter;
+    size_t num_iters = 512 * 1024 * 1024;
+    size_t num_bins = 1000;
+    std::pair<float, float> axis_range = {0., 1.};
+    std::vector<size_t> batch_sizes;  // Empty = per-section defaults
+    std::vector<size_t> sweep_bins = {10, 1000, 30000, 1000000, 10000000};
+    std::vector<size_t> scaling_threads;  // Empty = 1, 2, 4... all CPUs
+    size_t warmup_runs = 1;
+    size_t repetitions = 5;
+    std::string pinning = "none";
+    bool counters = false;
+    std::string coords = "rng";
+    std::string distribution = "uniform";
+    size_t buffer_coords = 64 * 1024 * 1024;
+    bool huge_pages = true;
+};
+//
+BenchConfig config;
+
+// Bin count used to test atomic bins under heavy contention
+constexpr size_t NUM_CONTENDED_BINS = 4;
+
+// Largest batch size for which ROOT's buffered fillers are instantiated. Their
+// batch sizes must be known at compile time, so those are only instantiated
+// for powers of 2 up to this, see with_batch_size(). Other benchmarks accept
+// any batch size.
+constexpr size_t MAX_BATCH_SIZE = 65536;
 
 // For now, we'll be studying 1D hists with integer bins
 //
@@ -27,12 +85,97 @@ constexpr std::pair<float, float> AXIS_RANGE = {0., 1.};
 //
 using Hist1D = RExp::RHist<1, size_t>;
 
+// Same, but with bins that can be filled by many threads without a mutex
+using AtomicHist1D = RExp::RHist<1, RelaxedAtomic<size_t>>;
+
+// 3D histograms are used to compare coordinate storage layouts
+using Hist3D = RExp::RHist<3, size_t>;
+
+
+// Pre-generated stream of histogram coordinates (see --coords buffer)
+//
+// Generating coordinates up front takes the cost of the random number
+// generator out of the timed loops, and allows replaying distributions which
+// would be too expensive to sample on the fly. The buffer is meant to be much
+// larger than the CPU caches, so it is preferably backed by huge pages to
+// keep TLB misses from polluting the measurements.
+//
+class CoordBuffer {
+public:
+    CoordBuffer(size_t size, bool huge_pages)
+        : m_size(size)
+        , m_bytes(size * sizeof(double))
+    {
+#ifdef __linux__
+        // Try explicit huge pages first, then transparent ones
+        if ( huge_pages ) {
+            constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+            const size_t huge_bytes =
+                (m_bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE
+                    * HUGE_PAGE_SIZE;
+            void* data = mmap(nullptr, huge_bytes, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                              -1, 0);
+            if ( data != MAP_FAILED ) {
+                m_data = static_cast<double*>(data);
+                m_bytes = huge_bytes;
+                m_page_kind = "explicit huge pages";
+                return;
+            }
+        }
+        void* data = mmap(nullptr, m_bytes, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if ( data == MAP_FAILED ) {
+            throw std::runtime_error("Failed to allocate coordinate buffer");
+        }
+        m_data = static_cast<double*>(data);
+        if ( huge_pages && (madvise(data, m_bytes, MADV_HUGEPAGE) == 0) ) {
+            m_page_kind = "transparent huge pages";
+        }
+#else
+        (void)huge_pages;
+        m_data = new double[size];
+#endif
+    }
+
+    CoordBuffer(const CoordBuffer&) = delete;
+    CoordBuffer& operator=(const CoordBuffer&) = delete;
+
+    ~CoordBuffer() {
+#ifdef __linux__
+        munmap(m_data, m_bytes);
+#else
+        delete[] m_data;
+#endif
+    }
+
+    double* data() { return m_data; }
+    const double* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    size_t bytes() const { return m_bytes; }
+
+    // Kind of memory pages backing the buffer, for display purposes
+    const std::string& page_kind() const { return m_page_kind; }
+
+private:
+    double* m_data;
+    size_t m_size;
+    size_t m_bytes;
+    std::string m_page_kind = "regular pages";
+};
+//
+// Set up by main() in --coords buffer mode, replayed by RandomCoords
+std::unique_ptr<CoordBuffer> coord_buffer;
+
 
 // Source of "random" data points for histograms
 //
 // Always produces the same sequence of random numbers, to guarantee that all
 // benchmarks are subjecting their histograms to the same workload.
 //
+// In --coords buffer mode, the coordinates are replayed from coord_buffer
+// instead, wrapping around when its end is reached.
+//
 class RandomCoords {
 public:
     // Generate a random point in the histogram's axis range
@@ -42,214 +185,2063 @@ public:
     // to implement correctly. We don't care about the tiny bias that ensues.
     //
     RExp::Hist::RCoordArray<1> gen() {
-        static constexpr float a = (AXIS_RANGE.second - AXIS_RANGE.first)
-                                     / (RNG::max() - RNG::min());
-        static constexpr float b = AXIS_RANGE.first;
-        return { a * m_gen() + b };
+        return { gen_coord() };
+    }
+
+    // Generate a random coordinate in the axis range, for multi-dimensional
+    // histograms which need more than one of them per data point
+    double gen_coord() {
+        if ( m_replay ) {
+            const double coord = m_replay[m_replay_pos];
+            if ( ++m_replay_pos == m_replay_size ) m_replay_pos = 0;
+            return coord;
+        }
+        return m_scale * m_gen() + m_offset;
     }
 
     // Skip N random rolls
-    void discard(std::size_t num_rolls) { m_gen.discard(num_rolls); }
+    //
+    // This is O(N) for the random number generator, but O(1) in replay mode.
+    //
+    void discard(std::size_t num_rolls) {
+        if ( m_replay ) {
+            m_replay_pos = (m_replay_pos + num_rolls) % m_replay_size;
+        } else {
+            m_gen.discard(num_rolls);
+        }
+    }
+
+    // Move to the start of thread thread_id's share of the data points, when
+    // num_threads threads split the work and this thread's share starts at
+    // data point first_iter of the sequential stream
+    //
+    // With the random number generator, this reproduces the sequential
+    // stream. In replay mode, the iteration count can exceed the buffer
+    // size, in which case skipping first_iter coordinates could send several
+    // threads to the same place. So the buffer is split into num_threads
+    // equal slices instead, one per thread.
+    //
+    void seek_thread_share(size_t thread_id,
+                           size_t num_threads,
+                           size_t first_iter) {
+        if ( m_replay ) {
+            discard(thread_id * m_replay_size / num_threads);
+        } else {
+            discard(first_iter);
+        }
+    }
 
 private:
     using RNG = std::mt19937;
     RNG m_gen;
+    float m_scale = (config.axis_range.second - config.axis_range.first)
+                        / (RNG::max() - RNG::min());
+    float m_offset = config.axis_range.first;
+
+    const double* m_replay = coord_buffer ? coord_buffer->data() : nullptr;
+    size_t m_replay_size = coord_buffer ? coord_buffer->size() : 0;
+    size_t m_replay_pos = 0;
 };
 
 
-// Basic microbenchmark harness
-void bench(const std::string& name,
-           std::function<Hist1D(Hist1D&&, RandomCoords&&)>&& work)
+// Fill a coordinate buffer according to config.distribution
+//
+// The uniform distribution is the one of RandomCoords, so that it produces the
+// same workload as the on-the-fly random number generation mode. The gaussian
+// distribution is a more realistic mixture of a few peaks of various widths
+// over a flat background, whose entries concentrate on fewer bins.
+//
+void generate_coords(CoordBuffer& buffer)
 {
-    using namespace std::chrono;
-    std::cout << "* " << name;
+    double* data = buffer.data();
+    if ( config.distribution == "uniform" ) {
+        RandomCoords rng;
+        for ( size_t i = 0; i < buffer.size(); ++i ) {
+            data[i] = rng.gen_coord();
+        }
+        return;
+    }
 
-    // Run benchmark
-    auto start = high_resolution_clock::now();
-    Hist1D hist = work(Hist1D{{NUM_BINS,
-                               AXIS_RANGE.first,
-                               AXIS_RANGE.second}},
-                       RandomCoords{});
-    auto end = high_resolution_clock::now();
+    // Peaks, as (position, width, share of entries) fractions of the axis
+    // range and data set. The remaining entries form the flat background.
+    struct Peak {
+        double position;
+        double width;
+        double share;
+    };
+    constexpr std::array<Peak, 3> PEAKS{{
+        {0.25, 0.02, 0.3},
+        {0.5, 0.05, 0.4},
+        {0.8, 0.005, 0.1},
+    }};
+    const double axis_min = config.axis_range.first;
+    const double axis_width = config.axis_range.second - axis_min;
 
-    // Check output histogram
-    if ( hist.GetEntries() != NUM_ITERS ) {
-        throw std::runtime_error("Bad number of histogram entries");
+    std::mt19937 gen;
+    std::uniform_real_distribution<double> uniform{0., 1.};
+    std::normal_distribution<double> normal;
+    for ( size_t i = 0; i < buffer.size(); ++i ) {
+        double choice = uniform(gen);
+        double coord = uniform(gen);
+        for ( const Peak& peak: PEAKS ) {
+            if ( choice < peak.share ) {
+                coord = peak.position + peak.width * normal(gen);
+                break;
+            }
+            choice -= peak.share;
+        }
+        data[i] = axis_min + axis_width * coord;
     }
-    // TODO: More correctness assertions would be nice:
-    //       - Record output of first benchmark run
-    //       - Check that number & contents of bins are identical for next runs
-    //       - Can also dive into GetImpl, at a future compatibility cost.
+}
+
+
+// Build a histogram with num_bins bins along each of its axes
+template <class Hist, size_t... AXES>
+Hist make_hist(size_t num_bins, std::index_sequence<AXES...>)
+{
+    const RExp::RAxisConfig axis{int(num_bins),
+                                 config.axis_range.first,
+                                 config.axis_range.second};
+    return Hist{std::array<RExp::RAxisConfig, sizeof...(AXES)>{
+        ((void)AXES, axis)...
+    }};
+}
 
-    // Print measured timing
-    auto nanos_per_iter = duration_cast<duration<float, std::nano>>(end - start)
-                              / NUM_ITERS;
-    std::cout << " -> " << nanos_per_iter.count() << " ns/iter" << std::endl;
+
+// Truth that a benchmark was selected by the --filter command line option
+bool selected(const std::string& name)
+{
+    return name.find(config.filter) != std::string::npos;
 }
 
 
-// Some benchmarks depend on a batch size parameter that must be known at
-// compile time. We need to generate those using a template.
+// Hardware and software performance counters, read via perf_event_open
 //
-// BATCH_SIZE should be a power of 2 in order to evenly divide NUM_ITERS
+// Counters are opened disabled, with inheritance enabled so that they also
+// count the activity of the worker threads which parallel benchmarks spawn
+// after start(). Counters which the host does not support, or which we are not
+// allowed to use (e.g. in containers or with a restrictive
+// kernel.perf_event_paranoid setting), are silently left out. If none can be
+// opened, available() is false and per_point() returns nothing.
 //
-template <size_t BATCH_SIZE>
-void batch_benches()
-{
-    std::cout << "=== BATCH SIZE: " << BATCH_SIZE << " ===" << std::endl;
+// The default set of counters is reported by --counters. A cycles + task clock
+// pair is also used to measure the clock frequency of the benchmark threads,
+// see ClockMonitor.
+//
+class PerfCounters {
+public:
+    // Name, type and config of a perf event
+    struct Event {
+        const char* name;
+        uint32_t type;
+        uint64_t config;
+    };
 
-    // Manually insert data points in batches using FillN()
-    //
-    // Amortizes some of the indirection.
-    //
-    bench("Manually-batched FillN()", [&](Hist1D&& hist,
-                                          RandomCoords&& rng) -> Hist1D {
-        std::vector<RExp::Hist::RCoordArray<1>> batch;
-        batch.reserve(BATCH_SIZE);
-        for ( size_t i = 0; i < NUM_ITERS / BATCH_SIZE; ++i ) {
-            batch.clear();
-            for ( size_t j = 0; j < BATCH_SIZE; ++j ) {
-                batch.push_back(rng.gen());
-            }
-            hist.FillN(batch);
+    // Counters that are reported by --counters
+    static std::vector<Event> default_events() {
+#ifdef __linux__
+        auto cache_event = [](uint64_t cache, uint64_t op, uint64_t result) {
+            return cache | (op << 8) | (result << 16);
+        };
+        return {
+            { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+            { "instructions",
+              PERF_TYPE_HARDWARE,
+              PERF_COUNT_HW_INSTRUCTIONS },
+            { "L1D misses",
+              PERF_TYPE_HW_CACHE,
+              cache_event(PERF_COUNT_HW_CACHE_L1D,
+                          PERF_COUNT_HW_CACHE_OP_READ,
+                          PERF_COUNT_HW_CACHE_RESULT_MISS) },
+            { "LLC misses",
+              PERF_TYPE_HW_CACHE,
+              cache_event(PERF_COUNT_HW_CACHE_LL,
+                          PERF_COUNT_HW_CACHE_OP_READ,
+                          PERF_COUNT_HW_CACHE_RESULT_MISS) },
+            { "branch misses",
+              PERF_TYPE_HARDWARE,
+              PERF_COUNT_HW_BRANCH_MISSES },
+            { "context switches",
+              PERF_TYPE_SOFTWARE,
+              PERF_COUNT_SW_CONTEXT_SWITCHES },
+        };
+#else
+        return {};
+#endif
+    }
+
+    explicit PerfCounters(const std::vector<Event>& events = default_events())
+    {
+#ifdef __linux__
+        for ( const Event& event: events ) {
+            open(event.name, event.type, event.config);
         }
-        return hist;
-    });
+#else
+        (void)events;
+#endif
+    }
 
-    // Let ROOT7 do the batch insertion work for us
-    //
-    // Can be slightly slower than manual batching because RHistBufferedFill
-    // buffers and records weights even when we don't need them.
-    //
-    bench("ROOT-batched Fill()", [&](Hist1D&& hist,
-                                     RandomCoords&& rng) -> Hist1D {
-        RExp::RHistBufferedFill<Hist1D, BATCH_SIZE> buf_hist{hist};
-        for ( size_t i = 0; i < NUM_ITERS; ++i ) {
-            buf_hist.Fill(rng.gen());
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    ~PerfCounters() {
+#ifdef __linux__
+        for ( const auto& counter: m_counters ) close(counter.fd);
+#endif
+    }
+
+    // Truth that at least one counter could be opened
+    bool available() const {
+#ifdef __linux__
+        return !m_counters.empty();
+#else
+        return false;
+#endif
+    }
+
+    // Reset the counters and start counting
+    void start() {
+#ifdef __linux__
+        for ( const auto& counter: m_counters ) {
+            ioctl(counter.fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(counter.fd, PERF_EVENT_IOC_ENABLE, 0);
         }
-        return hist;
-    });
+#endif
+    }
 
-    // Sequential use of RHistConcurrentFiller
-    //
-    // Combines batching akin to the one of RHistBufferedFill with mutex
-    // protection on the histogram of interest.
-    //
-    bench("Serial \"concurrent\" Fill()", [&](Hist1D&& hist,
-                                              RandomCoords&& rng) -> Hist1D {
-        RExp::RHistConcurrentFillManager<Hist1D, BATCH_SIZE> conc_hist{hist};
-        auto conc_hist_filler = conc_hist.MakeFiller();
-        for ( size_t i = 0; i < NUM_ITERS; ++i ) {
-            conc_hist_filler.Fill(rng.gen());
+    // Stop counting
+    void stop() {
+#ifdef __linux__
+        for ( const auto& counter: m_counters ) {
+            ioctl(counter.fd, PERF_EVENT_IOC_DISABLE, 0);
         }
-        return hist;
-    });
+#endif
+    }
 
-    // Parallel use of RHistConcurrentFiller
-    bench("Parallel concurrent Fill()", [&](Hist1D&& hist,
-                                            RandomCoords&& rng) -> Hist1D {
-        // Shared concurrent histogram filler
-        RExp::RHistConcurrentFillManager<Hist1D, BATCH_SIZE> conc_hist{hist};
+    // Read the counters, divided by the number of data points that were
+    // filled while they were counting. Counts are extrapolated if the kernel
+    // had to multiplex counters, and unreadable counters are left out.
+    std::vector<std::pair<std::string, double>>
+    per_point(size_t num_points) const {
+        std::vector<std::pair<std::string, double>> result;
+#ifdef __linux__
+        for ( const auto& counter: m_counters ) {
+            // Layout set by read_format in open()
+            uint64_t values[3];
+            if ( read(counter.fd, values, sizeof(values))
+                     != ssize_t(sizeof(values)) ) {
+                continue;
+            }
+            const uint64_t count = values[0];
+            const uint64_t time_enabled = values[1];
+            const uint64_t time_running = values[2];
+            if ( time_running == 0 ) continue;
+            const double scaled_count =
+                double(count) * time_enabled / time_running;
+            result.emplace_back(counter.name, scaled_count / num_points);
+        }
+#else
+        (void)num_points;
+#endif
+        return result;
+    }
+
+private:
+#ifdef __linux__
+    // Open a counter, keep it if that worked
+    void open(const char* name, uint32_t type, uint64_t event_config) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = event_config;
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+                           | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        // Try counting kernel activity too (where the context switches
+        // happen), fall back to user space only if that is not allowed
+        for ( int exclude_kernel = 0; exclude_kernel <= 1; ++exclude_kernel ) {
+            attr.exclude_kernel = exclude_kernel;
+            const long fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+            if ( fd >= 0 ) {
+                m_counters.push_back(Counter{name, int(fd)});
+                return;
+            }
+        }
+    }
 
-        // Only check the host CPU's thread count once
-        // FIXME: local_iters will not evenly divide NUM_ITERS if the host
-        //        computer's CPU thread count is not a power of 2
-        static const auto num_threads = std::thread::hardware_concurrency();
-        static const auto local_iters = NUM_ITERS / num_threads;
+    struct Counter {
+        std::string name;
+        int fd;
+    };
+    std::vector<Counter> m_counters;
+#endif
+};
 
-        // Thread startup synchronization + storage for worker threads
-        auto barrier = std::atomic{num_threads};
-        auto threads = std::vector<std::thread>{};
-        threads.reserve(num_threads-1);
 
-        // Threads (including ourselves) will do this:
-        auto work = [&]( size_t thread_id ) {
-            // Setup thread-local RNG and histogram filler
-            auto local_rng = rng;
-            local_rng.discard(thread_id * local_iters);
-            auto conc_hist_filler = conc_hist.MakeFiller();
+// Measures the average clock frequency of the CPU cores which the benchmark
+// threads ran on, in GHz, while they were running
+//
+// This divides the CPU cycles spent by the benchmark threads by the time that
+// they spent running, both counted by the kernel for each thread (including
+// the worker threads of parallel benchmarks, which inherit the counters). It
+// thus sees frequency changes that happen during the run, such as turbo boost
+// running out of thermal headroom or AVX-induced downclocking, on every core
+// that took part. measure() returns NaN if cycles cannot be counted.
+//
+class ClockMonitor {
+public:
+    ClockMonitor()
+#ifdef __linux__
+        : m_counters({
+              { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+              { "task clock", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+          })
+#endif
+    {}
 
-            // Signal that we are ready + wait for other threads to be ready
-            barrier.fetch_sub(1, std::memory_order_release);
-            while (barrier.load(std::memory_order_acquire)) {}
+    // Truth that clock frequencies can be measured on this host
+    bool available() {
+        start();
+        return !std::isnan(stop());
+    }
 
-            // Fill the histogram, then let it auto-flush via the destructor
-            for ( size_t i = 0; i < local_iters; ++i ) {
-                conc_hist_filler.Fill(local_rng.gen());
-            }
-        };
+    // Start measuring
+    void start() { m_counters.start(); }
 
-        // Start all secondary threads
-        for ( size_t thread_id = 1; thread_id < num_threads; ++thread_id ) {
-            threads.emplace_back([&] { work(thread_id); });
+    // Stop measuring and return the average clock frequency since start()
+    double stop() {
+        m_counters.stop();
+        double cycles = 0., task_clock_ns = 0.;
+        for ( const auto& [name, count]: m_counters.per_point(1) ) {
+            if ( name == "cycles" ) cycles = count;
+            if ( name == "task clock" ) task_clock_ns = count;
         }
+        return ((cycles > 0.) && (task_clock_ns > 0.))
+                   ? cycles / task_clock_ns
+                   : std::numeric_limits<double>::quiet_NaN();
+    }
+
+private:
+    PerfCounters m_counters;
+};
 
-        // Do our share of the work
-        work(0);
 
-        // Wait for all secondary threads to finish
-        for ( auto& thread: threads ) {
-            thread.join();
+// Timing statistics of a benchmark, over its timed repetitions
+struct Timing {
+    // Time per iteration, in nanoseconds
+    float median;
+    float mad;  // Median absolute deviation from the median
+    float min;
+
+    // Average clock frequency of the CPU cores running the benchmark threads
+    // in each timed repetition, in GHz (see ClockMonitor): median, minimum
+    // and maximum over repetitions. NaN if not measurable on this host.
+    double clock_ghz;
+    double clock_ghz_min;
+    double clock_ghz_max;
+
+    // Performance counters per filled data point, over all timed repetitions
+    // (empty unless enabled with --counters and available)
+    std::vector<std::pair<std::string, double>> counters;
+
+    // Truth that the clock frequency changed by more than 5% between
+    // repetitions, which makes the results hard to interpret
+    bool clock_changed() const {
+        return (clock_ghz_max - clock_ghz_min) > 0.05 * clock_ghz_min;
+    }
+};
+
+
+// Median of a set of measurements
+float median(std::vector<float> values)
+{
+    std::sort(values.begin(), values.end());
+    const size_t middle = values.size() / 2;
+    return (values.size() % 2 == 1)
+               ? values[middle]
+               : (values[middle - 1] + values[middle]) / 2;
+}
+
+
+// Basic microbenchmark harness
+//
+// Runs "work" on a histogram of type Hist with num_bins bins along each axis,
+// config.warmup_runs times without timing, then config.repetitions times with
+// timing. Checks the output of each run and returns statistics on the time
+// taken per iteration. bench_hist() below prints them, if the benchmark is
+// selected, and the bench() shorthand covers the common Hist1D case.
+//
+template <class Hist>
+Timing time_hist(size_t num_bins,
+                 std::function<Hist(Hist&&, RandomCoords&&)>&& work)
+{
+    using namespace std::chrono;
+
+    // Run the benchmark once, returning the time taken per iteration, and
+    // measuring the clock frequency of the benchmark threads meanwhile
+    ClockMonitor clock_monitor;
+    double run_clock_ghz = 0.;
+    auto run = [&]() -> float {
+        clock_monitor.start();
+        auto start = high_resolution_clock::now();
+        Hist hist = work(make_hist<Hist>(num_bins,
+                                         std::make_index_sequence<
+                                             Hist::GetNDim()
+                                         >{}),
+                         RandomCoords{});
+        auto end = high_resolution_clock::now();
+        run_clock_ghz = clock_monitor.stop();
+
+        // Check output histogram
+        if ( hist.GetEntries() != int64_t(config.num_iters) ) {
+            throw std::runtime_error("Bad number of histogram entries");
         }
+        // TODO: More correctness assertions would be nice:
+        //       - Record output of first benchmark run
+        //       - Check that number & contents of bins are identical for next
+        //         runs
+        //       - Can also dive into GetImpl, at a future compatibility cost.
 
-        // Output the final histogram
-        return hist;
-    });
+        // Compute timing per iteration
+        auto nanos_per_iter = duration_cast<duration<float, std::nano>>(
+                                  end - start
+                              ) / config.num_iters;
+        return nanos_per_iter.count();
+    };
 
-    // TODO: Compare with other synchronization strategies
-    //       - Fill thread-local histograms, merge at the end
-    //       - Use std::atomic<BinData> as the bin data type
-    //       - Use a specialized variant of std::atomic that performes relaxed
-    //         atomic operations instead of sequentially consistent ones, to
-    //         avoid unnecessary memory barrier overhead.
-    //
-    //       Will probably want to factor out redundant parts from the MT test
-    //       harness above when that time comes.
-    //
-    //       Not sure how compatible these other sync strategies are with
-    //       complex binning schemes such as growable axes.
+    // Warm up caches, branch predictors, page tables and CPU clocks
+    for ( size_t i = 0; i < config.warmup_runs; ++i ) {
+        run();
+    }
+
+    // Do the timed runs
+    Timing timing;
+    std::unique_ptr<PerfCounters> counters;
+    if ( config.counters ) {
+        counters = std::make_unique<PerfCounters>();
+        counters->start();
+    }
+    std::vector<float> times;
+    std::vector<double> clocks_ghz;
+    for ( size_t i = 0; i < config.repetitions; ++i ) {
+        times.push_back(run());
+        clocks_ghz.push_back(run_clock_ghz);
+    }
+    if ( counters ) {
+        counters->stop();
+        timing.counters =
+            counters->per_point(config.num_iters * config.repetitions);
+    }
+
+    // Compute clock statistics (NaNs, if any, are all or nothing)
+    std::sort(clocks_ghz.begin(), clocks_ghz.end());
+    timing.clock_ghz = clocks_ghz[clocks_ghz.size() / 2];
+    timing.clock_ghz_min = clocks_ghz.front();
+    timing.clock_ghz_max = clocks_ghz.back();
 
+    // Compute timing statistics
+    timing.median = median(times);
+    std::vector<float> deviations;
+    for ( const float time: times ) {
+        deviations.push_back(std::abs(time - timing.median));
+    }
+    timing.mad = median(deviations);
+    timing.min = *std::min_element(times.begin(), times.end());
+    return timing;
+}
+//
+template <class Hist>
+void bench_hist(const std::string& name,
+                size_t num_bins,
+                std::function<Hist(Hist&&, RandomCoords&&)>&& work)
+{
+    if ( !selected(name) ) return;
+    std::cout << "* " << name;
+    const Timing timing = time_hist<Hist>(num_bins, std::move(work));
+    std::cout << " -> " << timing.median << " ns/iter";
+    if ( config.repetitions > 1 ) {
+        std::cout << " (MAD " << timing.mad << ", min " << timing.min << ")";
+    }
     std::cout << std::endl;
+    if ( !timing.counters.empty() ) {
+        std::cout << "  Per point:";
+        for ( size_t i = 0; i < timing.counters.size(); ++i ) {
+            const auto& counter = timing.counters[i];
+            std::cout << ((i == 0) ? " " : ", ") << counter.second << ' '
+                      << counter.first;
+        }
+        std::cout << std::endl;
+    }
+    if ( timing.clock_changed() ) {
+        std::cout << "  WARNING: CPU clock varied from "
+                  << timing.clock_ghz_min << " to "
+                  << timing.clock_ghz_max << " GHz across repetitions"
+                  << std::endl;
+    }
+}
+//
+void bench(const std::string& name,
+           std::function<Hist1D(Hist1D&&, RandomCoords&&)>&& work)
+{
+    bench_hist<Hist1D>(name, config.num_bins, std::move(work));
 }
 
 
-// Top-level benchmark logic
-int main()
+// CPUs which this process is allowed to run on
+//
+// This may be fewer than std::thread::hardware_concurrency(), and need not be
+// numbered contiguously from 0, e.g. when running under taskset or inside of
+// a container with a CPU set.
+//
+std::vector<int> allowed_cpus()
+{
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    if ( sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0 ) {
+        for ( int cpu = 0; cpu < CPU_SETSIZE; ++cpu ) {
+            if ( CPU_ISSET(cpu, &cpu_set) ) cpus.push_back(cpu);
+        }
+    }
+#endif
+    if ( cpus.empty() ) {
+        const int num_cpus = std::max(std::thread::hardware_concurrency(), 1u);
+        for ( int cpu = 0; cpu < num_cpus; ++cpu ) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+
+// Thread configuration of parallel benchmarks
+//
+// By default, parallel benchmarks use all CPU threads and let the OS schedule
+// them. The thread scaling sweep changes this to run on fewer threads, pinned
+// to specific CPUs.
+//
+struct ParallelConfig {
+    // Number of threads which fill the histogram
+    size_t num_threads = allowed_cpus().size();
+
+    // CPU which each thread should be pinned to, or empty for no pinning
+    std::vector<int> cpus;
+};
+//
+ParallelConfig parallel_config;
+
+
+// Thread counts studied by thread scaling measurements: config.scaling_threads,
+// or by default powers of 2 up to the number of allowed CPUs, plus that number
+// if it is not a power of 2
+std::vector<size_t> scaling_thread_counts()
 {
-    std::cout << "=== NO BATCHING ===" << std::endl;
+    if ( !config.scaling_threads.empty() ) return config.scaling_threads;
+    const size_t max_threads = allowed_cpus().size();
+    std::vector<size_t> thread_counts;
+    for ( size_t threads = 1; threads < max_threads; threads *= 2 ) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+    return thread_counts;
+}
 
-    // Unoptimized sequential Fill() pattern
-    //
-    // Pretty slow, as it goes through a layer of pImpl indirection...
-    //
-    bench("Scalar Fill()", [&](Hist1D&& hist,
-                               RandomCoords&& rng) -> Hist1D {
-        for ( size_t i = 0; i < NUM_ITERS; ++i ) {
-            hist.Fill(rng.gen());
+
+// Orders in which the scaling sweep assigns threads to CPUs
+//
+// "compact" fills up all hyperthreads of a CPU core before moving to the next
+// one, whereas "spread" uses one hyperthread per core until all cores are in
+// use. Both are empty if the CPU topology cannot be queried (non-Linux OS).
+//
+struct CpuPlacements {
+    std::vector<int> compact;
+    std::vector<int> spread;
+};
+//
+CpuPlacements cpu_placements()
+{
+    // Read the package and core ID of every allowed CPU from sysfs
+    std::vector<std::tuple<int, int, int, int>> cpus;  // package, core, SMT, ID
+    for ( const int cpu: allowed_cpus() ) {
+        const std::string topology = "/sys/devices/system/cpu/cpu"
+                                         + std::to_string(cpu) + "/topology/";
+        std::ifstream package_file{topology + "physical_package_id"};
+        std::ifstream core_file{topology + "core_id"};
+        int package, core;
+        if ( !(package_file >> package) || !(core_file >> core) ) return {};
+
+        // Number hyperthreads within each core
+        int smt = 0;
+        for ( const auto& other: cpus ) {
+            smt += (std::get<0>(other) == package)
+                       && (std::get<1>(other) == core);
         }
-        return hist;
-    });
+        cpus.emplace_back(package, core, smt, cpu);
+    }
 
-    std::cout << std::endl;
+    // Sort them in each placement order
+    CpuPlacements placements;
+    std::sort(cpus.begin(), cpus.end());
+    for ( const auto& cpu: cpus ) {
+        placements.compact.push_back(std::get<3>(cpu));
+    }
+    std::stable_sort(cpus.begin(), cpus.end(),
+                     [](const auto& a, const auto& b) {
+                         return std::get<2>(a) < std::get<2>(b);
+                     });
+    for ( const auto& cpu: cpus ) {
+        placements.spread.push_back(std::get<3>(cpu));
+    }
+    return placements;
+}
 
-    // So, I heard that C++ doesn't have constexpr for loops...
-    batch_benches<1>();
-    batch_benches<2>();
-    batch_benches<4>();
-    batch_benches<8>();
-    batch_benches<16>();
-    batch_benches<32>();
-    batch_benches<64>();
-    batch_benches<128>();
-    batch_benches<256>();
-    batch_benches<512>();
-    batch_benches<1024>();
-    batch_benches<2048>();
-    batch_benches<4096>();
-    batch_benches<8192>();
-    batch_benches<16384>();
-    batch_benches<32768>();
-    batch_benches<65536>();
 
-    return 0;
-}
\ No newline at end of file
+// Pin the calling thread to a certain CPU
+void pin_current_thread(int cpu)
+{
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    if ( pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) ) {
+        throw std::runtime_error("Failed to pin thread to CPU "
+                                     + std::to_string(cpu));
+    }
+#else
+    (void)cpu;
+    throw std::runtime_error("Thread pinning is only supported on Linux");
+#endif
+}
+
+
+// Multi-threaded benchmark harness
+//
+// Splits the benchmark's iterations across the threads of
+// parallel_config. Each thread gets a copy of the RNG that is positioned at the
+// start of its share of the data points, and calls
+// "work(local_rng, local_iters, barrier)". After setting up its thread-local
+// state, "work" must call barrier.wait(), which blocks until all threads are
+// ready, then fill the histogram.
+//
+// All the work is done by secondary threads, so that pinning them does not
+// affect the main thread. If a thread cannot be pinned, it still does its
+// share of the work (so that the other threads are not left waiting at the
+// barrier), and the error is then rethrown by the main thread.
+//
+class StartBarrier {
+public:
+    explicit StartBarrier(size_t num_threads) : m_count{num_threads} {}
+
+    // Signal that we are ready + wait for other threads to be ready
+    void wait() {
+        m_count.fetch_sub(1, std::memory_order_release);
+        while (m_count.load(std::memory_order_acquire)) {}
+    }
+
+private:
+    std::atomic<size_t> m_count;
+};
+//
+template <typename Work>
+void run_parallel(const RandomCoords& rng, Work&& work)
+{
+    // Split iterations as evenly as possible across threads
+    const size_t num_threads = parallel_config.num_threads;
+    const size_t base_iters = config.num_iters / num_threads;
+    const size_t extra_iters = config.num_iters % num_threads;
+
+    // Thread startup synchronization + storage for worker threads
+    StartBarrier barrier{num_threads};
+    auto threads = std::vector<std::thread>{};
+    threads.reserve(num_threads);
+
+    // First error encountered by a thread, if any
+    std::mutex error_mutex;
+    std::exception_ptr error;
+    auto record_error = [&] {
+        std::lock_guard<std::mutex> lock{error_mutex};
+        if ( !error ) error = std::current_exception();
+    };
+
+    // Threads will do this:
+    auto thread_work = [&]( size_t thread_id ) {
+        if ( !parallel_config.cpus.empty() ) {
+            try {
+                pin_current_thread(parallel_config.cpus.at(thread_id));
+            } catch ( ... ) {
+                record_error();
+            }
+        }
+        const size_t local_iters = base_iters + (thread_id < extra_iters);
+        auto local_rng = rng;
+        local_rng.seek_thread_share(thread_id,
+                                    num_threads,
+                                    thread_id * base_iters
+                                        + std::min(thread_id, extra_iters));
+        work(local_rng, local_iters, barrier);
+    };
+
+    // Start all threads
+    for ( size_t thread_id = 0; thread_id < num_threads; ++thread_id ) {
+        threads.emplace_back([&, thread_id] {
+            try {
+                thread_work(thread_id);
+            } catch ( ... ) {
+                record_error();
+            }
+        });
+    }
+
+    // Wait for all threads to finish, then report their errors
+    for ( auto& thread: threads ) {
+        thread.join();
+    }
+    if ( error ) std::rethrow_exception(error);
+}
+
+
+// Parallel use of a fill manager, i.e. a class that is constructed from the
+// histogram (and extra constructor arguments) and hands out per-thread
+// fillers via MakeFiller(), which flush any buffered data when destroyed
+//
+// The manager is destroyed before the histogram is returned, since some
+// managers only finish filling the histogram in their destructor.
+//
+template <class Manager, class Hist, typename... Args>
+Hist parallel_managed_fill(Hist&& hist, RandomCoords&& rng, Args... args)
+{
+    {
+        // Shared histogram fill manager
+        Manager manager{hist, args...};
+
+        run_parallel(rng, [&](RandomCoords& local_rng,
+                              size_t local_iters,
+                              StartBarrier& barrier) {
+            // Setup thread-local histogram filler
+            auto filler = manager.MakeFiller();
+            barrier.wait();
+
+            // Fill the histogram, then let it auto-flush via the destructor
+            for ( size_t i = 0; i < local_iters; ++i ) {
+                filler.Fill(local_rng.gen());
+            }
+        });
+    }
+    return hist;
+}
+
+
+// Unoptimized sequential Fill() pattern
+Hist1D scalar_fill(Hist1D&& hist, RandomCoords&& rng)
+{
+    for ( size_t i = 0; i < config.num_iters; ++i ) {
+        hist.Fill(rng.gen());
+    }
+    return hist;
+}
+
+
+// Generate the benchmark's data points in batches of up to batch_size points,
+// and call process_batch(batch) on each batch
+template <typename ProcessBatch>
+void for_each_batch(RandomCoords& rng,
+                    size_t batch_size,
+                    ProcessBatch&& process_batch)
+{
+    std::vector<RExp::Hist::RCoordArray<1>> batch;
+    batch.reserve(batch_size);
+    for ( size_t start = 0; start < config.num_iters; start += batch_size ) {
+        batch.clear();
+        const size_t end = std::min(start + batch_size, config.num_iters);
+        for ( size_t i = start; i < end; ++i ) {
+            batch.push_back(rng.gen());
+        }
+        process_batch(batch);
+    }
+}
+
+
+// Manual insertion of data points in batches of a certain size using FillN()
+Hist1D manual_batch_fill(Hist1D&& hist,
+                         RandomCoords&& rng,
+                         size_t batch_size)
+{
+    for_each_batch(rng, batch_size, [&](const auto& batch) {
+        hist.FillN(batch);
+    });
+    return hist;
+}
+
+
+// Use of RHistBufferedFill, with a certain buffer size
+template <size_t BATCH_SIZE>
+Hist1D buffered_fill(Hist1D&& hist, RandomCoords&& rng)
+{
+    RExp::RHistBufferedFill<Hist1D, BATCH_SIZE> buf_hist{hist};
+    for ( size_t i = 0; i < config.num_iters; ++i ) {
+        buf_hist.Fill(rng.gen());
+    }
+    return hist;
+}
+
+
+// Parallel filling of thread-local histogram replicas, each filled through
+// an RHistBufferedFill with a certain buffer size
+template <size_t BATCH_SIZE>
+Hist1D parallel_replica_fill(Hist1D&& hist, RandomCoords&& rng)
+{
+    ReplicaFillManager<Hist1D> replicas{hist};
+
+    run_parallel(rng, [&](RandomCoords& local_rng,
+                          size_t local_iters,
+                          StartBarrier& barrier) {
+        // Setup thread-local histogram replica
+        RExp::RHistBufferedFill<Hist1D, BATCH_SIZE> buf_hist{
+            replicas.make_replica()
+        };
+        barrier.wait();
+
+        // Fill the replica
+        for ( size_t i = 0; i < local_iters; ++i ) {
+            buf_hist.Fill(local_rng.gen());
+        }
+    });
+
+    // Merge the replicas and output the final histogram
+    replicas.merge();
+    return hist;
+}
+
+
+// Parallel use of relaxed atomic bins
+AtomicHist1D parallel_atomic_fill(AtomicHist1D&& hist, RandomCoords&& rng)
+{
+    using Manager = RelaxedAtomicFillManager<AtomicHist1D>;
+    return parallel_managed_fill<Manager>(std::move(hist), std::move(rng));
+}
+
+
+// Parallel use of RHistConcurrentFiller, with a certain buffer size
+template <size_t BATCH_SIZE>
+Hist1D parallel_concurrent_fill(Hist1D&& hist, RandomCoords&& rng)
+{
+    using Manager = RExp::RHistConcurrentFillManager<Hist1D, BATCH_SIZE>;
+    return parallel_managed_fill<Manager>(std::move(hist), std::move(rng));
+}
+
+
+// Parallel use of UnweightedConcurrentFillManager, with a certain buffer size
+Hist1D parallel_unweighted_fill(Hist1D&& hist,
+                                RandomCoords&& rng,
+                                size_t batch_size)
+{
+    using Manager = UnweightedConcurrentFillManager<Hist1D>;
+    return parallel_managed_fill<Manager>(std::move(hist),
+                                          std::move(rng),
+                                          batch_size);
+}
+
+
+// Parallel use of QueuedFillManager, with a certain buffer size
+Hist1D parallel_queued_fill(Hist1D&& hist,
+                            RandomCoords&& rng,
+                            size_t batch_size)
+{
+    using Manager = QueuedFillManager<Hist1D>;
+    return parallel_managed_fill<Manager>(std::move(hist),
+                                          std::move(rng),
+                                          batch_size);
+}
+
+
+// Parallel use of StripedFillManager, with a certain buffer size and number
+// of stripes
+Hist1D parallel_striped_fill(Hist1D&& hist,
+                             RandomCoords&& rng,
+                             size_t batch_size,
+                             size_t num_stripes)
+{
+    using Manager = StripedFillManager<Hist1D>;
+    return parallel_managed_fill<Manager>(std::move(hist),
+                                          std::move(rng),
+                                          num_stripes,
+                                          batch_size);
+}
+
+
+// Parallel use of AggregatingConcurrentFillManager, with a certain buffer
+// size and aggregation threshold
+Hist1D parallel_aggregating_fill(Hist1D&& hist,
+                                 RandomCoords&& rng,
+                                 size_t batch_size,
+                                 size_t threshold)
+{
+    using Manager = AggregatingConcurrentFillManager<Hist1D>;
+    return parallel_managed_fill<Manager>(std::move(hist),
+                                          std::move(rng),
+                                          batch_size,
+                                          threshold);
+}
+
+
+// Benchmarks of ROOT's buffered fillers, with a buffer of BATCH_SIZE data
+// points, and of strategies that build on them
+template <size_t BATCH_SIZE>
+void buffered_benches()
+{
+    // Let ROOT7 do the batch insertion work for us
+    //
+    // Can be slightly slower than manual batching because RHistBufferedFill
+    // buffers and records weights even when we don't need them.
+    //
+    bench("ROOT-batched Fill()", buffered_fill<BATCH_SIZE>);
+
+    // Sequential use of RHistConcurrentFiller
+    //
+    // Combines batching akin to the one of RHistBufferedFill with mutex
+    // protection on the histogram of interest.
+    //
+    bench("Serial \"concurrent\" Fill()", [&](Hist1D&& hist,
+                                              RandomCoords&& rng) -> Hist1D {
+        RExp::RHistConcurrentFillManager<Hist1D, BATCH_SIZE> conc_hist{hist};
+        auto conc_hist_filler = conc_hist.MakeFiller();
+        for ( size_t i = 0; i < config.num_iters; ++i ) {
+            conc_hist_filler.Fill(rng.gen());
+        }
+        return hist;
+    });
+
+    // Parallel use of RHistConcurrentFiller
+    bench("Parallel concurrent Fill()",
+          parallel_concurrent_fill<BATCH_SIZE>);
+
+    // Parallel filling of thread-local histogram replicas
+    //
+    // Threads do not synchronize at all until the end, where the replicas are
+    // merged into the final histogram. Fills are batched as in the
+    // "ROOT-batched Fill()" benchmark.
+    //
+    bench("Parallel thread-local Fill()", parallel_replica_fill<BATCH_SIZE>);
+}
+
+
+// Benchmarks of our own buffered fillers, whose buffer size is chosen at
+// runtime and can thus be any number of data points
+void custom_buffered_benches(size_t batch_size)
+{
+    // Same as ROOT-batched Fill(), but without recording weights
+    //
+    // Our data points all have unit weight, so we only need to buffer their
+    // coordinates and can use the FillN() overload without weights.
+    //
+    bench("Unweighted batched Fill()", [&](Hist1D&& hist,
+                                           RandomCoords&& rng) -> Hist1D {
+        {
+            UnweightedBufferedFill<Hist1D> buf_hist{hist, batch_size};
+            for ( size_t i = 0; i < config.num_iters; ++i ) {
+                buf_hist.Fill(rng.gen());
+            }
+        }
+        return hist;
+    });
+
+    // Parallel use of an unweighted concurrent filler
+    bench("Parallel unweighted concurrent Fill()",
+          [&](Hist1D&& hist, RandomCoords&& rng) -> Hist1D {
+        return parallel_unweighted_fill(std::move(hist),
+                                        std::move(rng),
+                                        batch_size);
+    });
+
+    // Parallel use of a lock-free queue feeding a merger thread
+    //
+    // Filling threads never wait for the histogram, only for a free buffer
+    // if the merger thread falls behind. Note that the merger thread comes
+    // on top of the filling threads, which oversubscribes the CPU whenever
+    // it has buffers to merge (it sleeps otherwise).
+    //
+    bench("Parallel queued Fill()",
+          [&](Hist1D&& hist, RandomCoords&& rng) -> Hist1D {
+        return parallel_queued_fill(std::move(hist),
+                                    std::move(rng),
+                                    batch_size);
+    });
+
+    // Parallel use of a striped concurrent histogram
+    //
+    // Splits the histogram's bins across several locks, so that concurrent
+    // flushes mostly lock different stripes. More stripes reduce contention,
+    // but each stripe gets a smaller share of the buffered data points. As
+    // contention depends on the number of threads, each stripe count is
+    // measured at every thread count of the scaling sweep.
+    //
+    const size_t old_num_threads = parallel_config.num_threads;
+    for ( size_t num_stripes: {1, 4, 16, 64} ) {
+        for ( size_t num_threads: scaling_thread_counts() ) {
+            if ( !parallel_config.cpus.empty()
+                 && (num_threads > parallel_config.cpus.size()) ) break;
+            parallel_config.num_threads = num_threads;
+            bench("Parallel striped Fill(), " + std::to_string(num_stripes)
+                      + " stripes, " + std::to_string(num_threads)
+                      + " threads",
+                  [&](Hist1D&& hist, RandomCoords&& rng) -> Hist1D {
+                return parallel_striped_fill(std::move(hist),
+                                             std::move(rng),
+                                             batch_size,
+                                             num_stripes);
+            });
+        }
+    }
+    parallel_config.num_threads = old_num_threads;
+
+    // TODO: Not sure how compatible the thread-local and atomic strategies
+    //       are with complex binning schemes such as growable axes.
+}
+
+
+// Call f(std::integral_constant<size_t, BATCH_SIZE>{}), where BATCH_SIZE is
+// the compile-time equivalent of batch_size, for the sake of benchmarks whose
+// batch size must be known at compile time
+//
+// Only powers of 2 up to MAX_BATCH_SIZE are supported, as told by
+// is_static_batch_size(). Others are rejected by check_batch_size().
+//
+bool is_static_batch_size(size_t batch_size)
+{
+    return (batch_size != 0) && (batch_size <= MAX_BATCH_SIZE)
+           && ((batch_size & (batch_size - 1)) == 0);
+}
+//
+void check_batch_size(size_t batch_size)
+{
+    if ( !is_static_batch_size(batch_size) ) {
+        throw std::runtime_error("Unsupported batch size "
+                                     + std::to_string(batch_size)
+                                     + " (should be a power of 2 up to "
+                                     + std::to_string(MAX_BATCH_SIZE) + ")");
+    }
+}
+//
+template <typename F, size_t... LOG2_SIZES>
+void with_batch_size_impl(size_t batch_size,
+                          F& f,
+                          std::index_sequence<LOG2_SIZES...>)
+{
+    check_batch_size(batch_size);
+    (void)((batch_size == (size_t(1) << LOG2_SIZES)
+                ? (f(std::integral_constant<size_t,
+                                            size_t(1) << LOG2_SIZES>{}),
+                   true)
+                : false) || ...);
+}
+//
+template <typename F>
+void with_batch_size(size_t batch_size, F&& f)
+{
+    constexpr size_t NUM_BATCH_SIZES = 17;
+    static_assert(size_t(1) << (NUM_BATCH_SIZES - 1) == MAX_BATCH_SIZE,
+                  "NUM_BATCH_SIZES does not match MAX_BATCH_SIZE");
+    with_batch_size_impl(batch_size,
+                         f,
+                         std::make_index_sequence<NUM_BATCH_SIZES>{});
+}
+
+
+// Benchmarks which depend on a batch size parameter
+//
+// Most strategies work with any batch size, but ROOT's buffered fillers need
+// a buffer size that is known at compile time, so we generate those using a
+// template (see buffered_benches above) and skip them for batch sizes that
+// were not instantiated.
+//
+void batch_benches(size_t batch_size)
+{
+    std::cout << "=== BATCH SIZE: " << batch_size << " ===" << std::endl;
+
+    // Manually insert data points in batches using FillN()
+    //
+    // Amortizes some of the indirection.
+    //
+    bench("Manually-batched FillN()", [&](Hist1D&& hist,
+                                          RandomCoords&& rng) -> Hist1D {
+        return manual_batch_fill(std::move(hist), std::move(rng), batch_size);
+    });
+
+    // Same, but with bin indices computed using SIMD instructions
+    //
+    // Bypasses RHist's per-point virtual axis lookups, which only works for
+    // equidistant axes.
+    //
+    bench("Vectorized equidistant FillN()", [&](Hist1D&& hist,
+                                                RandomCoords&& rng) -> Hist1D {
+        EquidistantBatchFill<Hist1D> fast_hist{hist};
+        for_each_batch(rng, batch_size, [&](const auto& batch) {
+            fast_hist.FillN(batch);
+        });
+        return hist;
+    });
+
+    if ( is_static_batch_size(batch_size) ) {
+        with_batch_size(batch_size, [](auto batch_size_constant) {
+            buffered_benches<decltype(batch_size_constant)::value>();
+        });
+    } else {
+        std::cout << "(Skipping RHistBufferedFill-based benchmarks, which "
+                  << "need a power of 2 batch size up to " << MAX_BATCH_SIZE
+                  << ")" << std::endl;
+    }
+    custom_buffered_benches(batch_size);
+
+    std::cout << std::endl;
+}
+
+
+// Concurrent filling with a buffer size that adapts to lock contention
+//
+// These fillers have no compile-time batch size, so they get their own
+// benchmarks, which also report the buffer size that fillers settled on.
+//
+void adaptive_benches()
+{
+    std::cout << "=== ADAPTIVE BATCHING ===" << std::endl;
+
+    // Record what the fillers of an adaptive manager ended up doing, and
+    // report it once the benchmark timing has been printed
+    double contention_rate = 0., buffer_size = 0.;
+    auto record_stats = [&](const auto& manager) {
+        contention_rate = manager.contention_rate();
+        buffer_size = manager.mean_buffer_size();
+    };
+    auto print_stats = [&] {
+        std::cout << "  (contention rate: " << contention_rate
+                  << ", final buffer size: " << buffer_size << ")"
+                  << std::endl;
+    };
+
+    // Sequential use, which should settle on small buffers
+    bench("Serial adaptive \"concurrent\" Fill()",
+          [&](Hist1D&& hist, RandomCoords&& rng) -> Hist1D {
+        AdaptiveConcurrentFillManager<Hist1D> adaptive_hist{hist};
+        {
+            auto adaptive_hist_filler = adaptive_hist.MakeFiller();
+            for ( size_t i = 0; i < config.num_iters; ++i ) {
+                adaptive_hist_filler.Fill(rng.gen());
+            }
+        }
+        record_stats(adaptive_hist);
+        return hist;
+    });
+    print_stats();
+
+    // Parallel use, which should grow buffers until contention fades away
+    bench("Parallel adaptive Fill()",
+          [&](Hist1D&& hist, RandomCoords&& rng) -> Hist1D {
+        AdaptiveConcurrentFillManager<Hist1D> adaptive_hist{hist};
+
+        run_parallel(rng, [&](RandomCoords& local_rng,
+                              size_t local_iters,
+                              StartBarrier& barrier) {
+            // Setup thread-local histogram filler
+            auto adaptive_hist_filler = adaptive_hist.MakeFiller();
+            barrier.wait();
+
+            // Fill the histogram, then let it auto-flush via the destructor
+            for ( size_t i = 0; i < local_iters; ++i ) {
+                adaptive_hist_filler.Fill(local_rng.gen());
+            }
+        });
+
+        record_stats(adaptive_hist);
+        return hist;
+    });
+    print_stats();
+
+    std::cout << std::endl;
+}
+
+
+// Compare plain and pre-aggregated batch insertion for a certain batch size,
+// across histograms of various sizes
+//
+// Aggregation pays off when batches are large with respect to the number of
+// bins, so we force it (threshold 0) in order to see where the crossover is.
+//
+void aggregation_benches(size_t batch_size)
+{
+    for ( size_t num_bins: {NUM_CONTENDED_BINS,
+                            config.num_bins,
+                            1000 * config.num_bins} ) {
+        std::cout << "=== PRE-AGGREGATION, BATCH SIZE " << batch_size
+                  << ", " << num_bins << " BINS ===" << std::endl;
+
+        // Baseline: manually insert data points in batches using FillN()
+        bench_hist<Hist1D>("Manually-batched FillN()",
+                           num_bins,
+                           [&](Hist1D&& hist, RandomCoords&& rng) -> Hist1D {
+            return manual_batch_fill(std::move(hist),
+                                     std::move(rng),
+                                     batch_size);
+        });
+
+        // Same, but aggregating each batch before updating the bins
+        bench_hist<Hist1D>("Pre-aggregated FillN()",
+                           num_bins,
+                           [&](Hist1D&& hist, RandomCoords&& rng) -> Hist1D {
+            BatchAggregator<Hist1D> aggregator{hist, 0};
+            for_each_batch(rng, batch_size, [&](const auto& batch) {
+                aggregator.FillN(batch);
+            });
+            return hist;
+        });
+
+        // Baseline: parallel use of RHistConcurrentFiller, whose buffer
+        // size must be known at compile time
+        if ( is_static_batch_size(batch_size) ) {
+            with_batch_size(batch_size, [&](auto batch_size_constant) {
+                constexpr size_t BATCH_SIZE =
+                    decltype(batch_size_constant)::value;
+                bench_hist<Hist1D>("Parallel concurrent Fill()",
+                                   num_bins,
+                                   parallel_concurrent_fill<BATCH_SIZE>);
+            });
+        }
+
+        // Same, but aggregating each buffer before taking the lock
+        bench_hist<Hist1D>("Parallel pre-aggregated concurrent Fill()",
+                           num_bins,
+                           [&](Hist1D&& hist, RandomCoords&& rng) -> Hist1D {
+            return parallel_aggregating_fill(std::move(hist),
+                                             std::move(rng),
+                                             batch_size,
+                                             0);
+        });
+
+        std::cout << std::endl;
+    }
+}
+
+
+// Compare array-of-structs and structure-of-arrays batch insertion
+//
+// Our data comes in as one column per axis, as is common for event data, so
+// the array-of-structs FillN needs it to be repacked first. 3D histograms are
+// used so that the two layouts actually differ.
+//
+void columnar_benches(size_t batch_size)
+{
+    constexpr size_t NUM_BINS_PER_AXIS = 10;
+    using CoordArray3D = RExp::Hist::RCoordArray<3>;
+    std::cout << "=== COLUMNAR INPUT, 3D, BATCH SIZE " << batch_size
+              << " ===" << std::endl;
+
+    // Generate the benchmark's data points as batches of columnar input, and
+    // call process_batch(columns) on each batch
+    std::array<std::vector<double>, 3> columns;
+    for ( auto& column: columns ) {
+        column.resize(batch_size);
+    }
+    auto for_each_column_batch = [&](RandomCoords& rng, auto&& process_batch) {
+        const size_t num_iters = config.num_iters;
+        for ( size_t start = 0; start < num_iters; start += batch_size ) {
+            const size_t num_points = std::min(batch_size, num_iters - start);
+            for ( size_t j = 0; j < num_points; ++j ) {
+                for ( auto& column: columns ) {
+                    column[j] = rng.gen_coord();
+                }
+            }
+            process_batch(CoordColumns<3>{
+                std::span<const double>(columns[0].data(), num_points),
+                std::span<const double>(columns[1].data(), num_points),
+                std::span<const double>(columns[2].data(), num_points)
+            });
+        }
+    };
+
+    // Repack columns into an array of RCoordArray
+    std::vector<CoordArray3D> batch(batch_size);
+    auto repack = [&](const CoordColumns<3>& column_spans) {
+        const size_t num_points = column_spans[0].size();
+        for ( size_t j = 0; j < num_points; ++j ) {
+            batch[j] = { column_spans[0][j],
+                         column_spans[1][j],
+                         column_spans[2][j] };
+        }
+        return std::span<const CoordArray3D>(batch.data(), num_points);
+    };
+
+    // Array-of-structs FillN(), after repacking
+    bench_hist<Hist3D>("Repacked FillN()",
+                       NUM_BINS_PER_AXIS,
+                       [&](Hist3D&& hist, RandomCoords&& rng) -> Hist3D {
+        for_each_column_batch(rng, [&](const CoordColumns<3>& column_spans) {
+            hist.FillN(repack(column_spans));
+        });
+        return hist;
+    });
+
+    // Structure-of-arrays equivalent, without repacking
+    bench_hist<Hist3D>("Columnar fill_columns()",
+                       NUM_BINS_PER_AXIS,
+                       [&](Hist3D&& hist, RandomCoords&& rng) -> Hist3D {
+        for_each_column_batch(rng, [&](const CoordColumns<3>& column_spans) {
+            fill_columns(hist, column_spans);
+        });
+        return hist;
+    });
+
+    // Same comparison with vectorized bin index computations
+    bench_hist<Hist3D>("Repacked vectorized FillN()",
+                       NUM_BINS_PER_AXIS,
+                       [&](Hist3D&& hist, RandomCoords&& rng) -> Hist3D {
+        EquidistantBatchFill<Hist3D> fast_hist{hist};
+        for_each_column_batch(rng, [&](const CoordColumns<3>& column_spans) {
+            fast_hist.FillN(repack(column_spans));
+        });
+        return hist;
+    });
+    bench_hist<Hist3D>("Columnar vectorized FillN()",
+                       NUM_BINS_PER_AXIS,
+                       [&](Hist3D&& hist, RandomCoords&& rng) -> Hist3D {
+        EquidistantBatchFill<Hist3D> fast_hist{hist};
+        for_each_column_batch(rng, [&](const CoordColumns<3>& column_spans) {
+            fast_hist.FillN(column_spans);
+        });
+        return hist;
+    });
+
+    std::cout << std::endl;
+}
+
+
+// Compare relaxed atomic bins with RHistConcurrentFiller under full
+// contention, i.e. with all threads filling the same histogram all the time
+//
+// Atomic bins do not need batching, but suffer when many threads hammer the
+// same bins, so this is run with both a normal and a tiny number of bins.
+//
+void atomic_benches(size_t num_bins)
+{
+    std::cout << "=== RELAXED ATOMIC BINS, " << num_bins << " BINS ==="
+              << std::endl;
+
+    // Parallel use of relaxed atomic bins
+    bench_hist<AtomicHist1D>("Parallel relaxed atomic Fill()",
+                             num_bins,
+                             parallel_atomic_fill);
+
+    // Same with RHistConcurrentFiller, unbatched and with a batch size that
+    // is close to optimal on an 8-thread machine
+    bench_hist<Hist1D>("Parallel concurrent Fill(), batch size 1",
+                       num_bins,
+                       parallel_concurrent_fill<1>);
+    bench_hist<Hist1D>("Parallel concurrent Fill(), batch size 2048",
+                       num_bins,
+                       parallel_concurrent_fill<2048>);
+
+    std::cout << std::endl;
+}
+
+
+// Run every filling strategy on histograms whose bins fit in each level of
+// the memory hierarchy, for several batch sizes
+//
+// The output is one table per strategy, with a row per bin count and a column
+// per batch size, showing where strategies fall off a cache cliff. With 8-byte
+// bins, the default bin counts (config.sweep_bins) cover histograms sized for
+// L1, L2, L3 and DRAM on common CPUs. Beware that thread-local replicas of the
+// largest histogram take up a lot of RAM on machines with many threads.
+//
+void cache_sweep(const std::vector<size_t>& batch_sizes)
+{
+    std::cout << "=== BIN COUNT SWEEP (ns/iter) ===" << std::endl;
+
+    // Print the header of a strategy's table, for some column titles
+    auto print_header = [](const std::string& strategy,
+                           const std::vector<std::string>& columns) {
+        std::cout << "* " << strategy << std::endl;
+        std::cout << std::setw(10) << "bins";
+        for ( const auto& column: columns ) {
+            std::cout << std::setw(10) << column;
+        }
+        std::cout << std::endl;
+    };
+
+    // Print one row of a strategy's table. Batch sizes which a strategy does
+    // not support have a NaN timing.
+    auto print_row = [](size_t num_bins, const std::vector<Timing>& timings) {
+        std::cout << std::setw(10) << num_bins;
+        for ( const Timing& timing: timings ) {
+            if ( std::isnan(timing.median) ) {
+                std::cout << std::setw(10) << "n/a";
+            } else {
+                std::cout << std::setw(10) << timing.median;
+            }
+        }
+        std::cout << std::endl;
+    };
+
+    // Sweep a strategy which does not depend on the batch size, given a
+    // function that times it for a certain number of bins
+    auto sweep_unbatched = [&](const std::string& strategy, auto time_work) {
+        if ( !selected(strategy) ) return;
+        print_header(strategy, {"unbatched"});
+        for ( const size_t num_bins: config.sweep_bins ) {
+            print_row(num_bins, { time_work(num_bins) });
+        }
+        std::cout << std::endl;
+    };
+
+    // Sweep a strategy which depends on the batch size, given a function
+    // that times it for a certain number of bins and batch size
+    std::vector<std::string> batch_columns;
+    for ( const size_t batch_size: batch_sizes ) {
+        batch_columns.push_back(std::to_string(batch_size));
+    }
+    auto sweep_batched = [&](const std::string& strategy, auto time_work) {
+        if ( !selected(strategy) ) return;
+        print_header(strategy, batch_columns);
+        for ( const size_t num_bins: config.sweep_bins ) {
+            std::vector<Timing> timings;
+            for ( const size_t batch_size: batch_sizes ) {
+                timings.push_back(time_work(num_bins, batch_size));
+            }
+            print_row(num_bins, timings);
+        }
+        std::cout << std::endl;
+    };
+
+    // Time a strategy whose batch size must be known at compile time.
+    // make_work receives it as an std::integral_constant.
+    auto time_buffered = [](auto make_work) {
+        return [make_work](size_t num_bins, size_t batch_size) {
+            Timing timing{};
+            if ( !is_static_batch_size(batch_size) ) {
+                timing.median = std::numeric_limits<float>::quiet_NaN();
+                return timing;
+            }
+            with_batch_size(batch_size, [&](auto batch_size_constant) {
+                timing = time_hist<Hist1D>(num_bins,
+                                           make_work(batch_size_constant));
+            });
+            return timing;
+        };
+    };
+
+    sweep_unbatched("Scalar Fill()", [](size_t num_bins) {
+        return time_hist<Hist1D>(num_bins, scalar_fill);
+    });
+    sweep_batched("Manually-batched FillN()", [](size_t num_bins,
+                                                 size_t batch_size) {
+        return time_hist<Hist1D>(
+            num_bins,
+            [&](Hist1D&& hist, RandomCoords&& rng) -> Hist1D {
+                return manual_batch_fill(std::move(hist),
+                                         std::move(rng),
+                                         batch_size);
+            }
+        );
+    });
+    sweep_batched("ROOT-batched Fill()",
+                  time_buffered([](auto batch_size) {
+        return buffered_fill<decltype(batch_size)::value>;
+    }));
+    sweep_batched("Parallel concurrent Fill()",
+                  time_buffered([](auto batch_size) {
+        return parallel_concurrent_fill<decltype(batch_size)::value>;
+    }));
+    sweep_unbatched("Parallel relaxed atomic Fill()", [](size_t num_bins) {
+        return time_hist<AtomicHist1D>(num_bins, parallel_atomic_fill);
+    });
+    sweep_batched("Parallel thread-local Fill()",
+                  time_buffered([](auto batch_size) {
+        return parallel_replica_fill<decltype(batch_size)::value>;
+    }));
+}
+
+
+// Description of the machine that benchmarks are running on
+struct HostInfo {
+    std::string cpu_model;
+    std::string kernel;
+    std::string compiler;
+    std::string root_version;
+};
+//
+HostInfo host_info()
+{
+    HostInfo info;
+
+    // CPU model, from /proc/cpuinfo on Linux
+    info.cpu_model = "unknown";
+    std::ifstream cpuinfo{"/proc/cpuinfo"};
+    for ( std::string line; std::getline(cpuinfo, line); ) {
+        if ( line.rfind("model name", 0) == 0 ) {
+            const auto start = line.find(':');
+            if ( start != std::string::npos ) {
+                info.cpu_model = line.substr(line.find_first_not_of(' ',
+                                                                    start+1));
+            }
+            break;
+        }
+    }
+
+    // OS kernel
+    utsname uts;
+    info.kernel = (uname(&uts) == 0)
+                      ? std::string(uts.sysname) + " v" + uts.release
+                      : "unknown";
+
+    // Compiler and ROOT version, known at build time
+#if defined(__clang__)
+    info.compiler = "clang++ v" __clang_version__;
+#elif defined(__GNUC__)
+    info.compiler = "g++ v" __VERSION__;
+#else
+    info.compiler = "unknown";
+#endif
+    info.root_version = "v" ROOT_RELEASE;
+
+    return info;
+}
+
+
+// Quote a string for CSV output
+std::string csv_quote(const std::string& str)
+{
+    std::string result = "\"";
+    for ( const char c: str ) {
+        if ( c == '"' ) result += '"';
+        result += c;
+    }
+    return result + "\"";
+}
+
+
+// Quote a string for JSON output
+std::string json_quote(const std::string& str)
+{
+    std::string result = "\"";
+    for ( const char c: str ) {
+        if ( (c == '"') || (c == '\\') ) result += '\\';
+        result += c;
+    }
+    return result + "\"";
+}
+
+
+// Measure how parallel strategies scale with the number of threads, for
+// various thread placements, and save the results as CSV and JSON files along
+// with a description of the host for later analysis (see plotFillBench.py)
+//
+// Thread counts are given by scaling_thread_counts().
+//
+void scaling_sweep(const HostInfo& host,
+                   const std::string& csv_path,
+                   const std::string& json_path)
+{
+    constexpr size_t BATCH_SIZE = 2048;
+    std::cout << "=== THREAD SCALING, BATCH SIZE " << BATCH_SIZE << " ==="
+              << std::endl;
+
+    // Parallel strategies to be studied
+    using Strategy = std::pair<std::string, std::function<Timing()>>;
+    std::vector<Strategy> strategies = {
+        { "Parallel concurrent Fill()", [] {
+            return time_hist<Hist1D>(config.num_bins,
+                                     parallel_concurrent_fill<BATCH_SIZE>);
+        } },
+        { "Parallel unweighted concurrent Fill()", [] {
+            return time_hist<Hist1D>(
+                config.num_bins,
+                [](Hist1D&& hist, RandomCoords&& rng) -> Hist1D {
+                    return parallel_unweighted_fill(std::move(hist),
+                                                    std::move(rng),
+                                                    BATCH_SIZE);
+                }
+            );
+        } },
+        { "Parallel thread-local Fill()", [] {
+            return time_hist<Hist1D>(config.num_bins,
+                                     parallel_replica_fill<BATCH_SIZE>);
+        } },
+        { "Parallel queued Fill()", [] {
+            return time_hist<Hist1D>(
+                config.num_bins,
+                [](Hist1D&& hist, RandomCoords&& rng) -> Hist1D {
+                    return parallel_queued_fill(std::move(hist),
+                                                std::move(rng),
+                                                BATCH_SIZE);
+                }
+            );
+        } },
+        { "Parallel adaptive Fill()", [] {
+            return time_hist<Hist1D>(
+                config.num_bins,
+                parallel_managed_fill<AdaptiveConcurrentFillManager<Hist1D>,
+                                      Hist1D>
+            );
+        } },
+        { "Parallel pre-aggregated concurrent Fill()", [] {
+            return time_hist<Hist1D>(
+                config.num_bins,
+                [](Hist1D&& hist, RandomCoords&& rng) -> Hist1D {
+                    return parallel_aggregating_fill(
+                        std::move(hist),
+                        std::move(rng),
+                        BATCH_SIZE,
+                        BatchAggregator<Hist1D>::DEFAULT_THRESHOLD
+                    );
+                }
+            );
+        } },
+        { "Parallel relaxed atomic Fill()", [] {
+            return time_hist<AtomicHist1D>(config.num_bins,
+                                           parallel_atomic_fill);
+        } },
+    };
+    for ( size_t num_stripes: {1, 4, 16, 64} ) {
+        strategies.emplace_back(
+            "Parallel striped Fill(), " + std::to_string(num_stripes)
+                + " stripes",
+            [num_stripes] {
+                return time_hist<Hist1D>(
+                    config.num_bins,
+                    [num_stripes](Hist1D&& hist, RandomCoords&& rng) -> Hist1D {
+                        return parallel_striped_fill(std::move(hist),
+                                                     std::move(rng),
+                                                     BATCH_SIZE,
+                                                     num_stripes);
+                    }
+                );
+            }
+        );
+    }
+
+    // Thread placements to be studied
+    const auto placements = cpu_placements();
+    std::vector<std::pair<std::string, std::vector<int>>> placement_cpus = {
+        { "unpinned", {} }
+    };
+    if ( !placements.compact.empty() ) {
+        placement_cpus.emplace_back("compact", placements.compact);
+        placement_cpus.emplace_back("spread", placements.spread);
+    }
+
+    // Thread counts to be studied
+    const std::vector<size_t> thread_counts = scaling_thread_counts();
+
+    // Run the benchmarks, recording results as CSV and JSON
+    const ParallelConfig old_parallel_config = parallel_config;
+    std::ofstream csv{csv_path};
+    csv << "cpu_model,kernel,compiler,root_version,strategy,placement,"
+        << "threads,ns_per_iter,ns_per_iter_mad,ns_per_iter_min,clock_ghz"
+        << std::endl;
+    const std::string csv_host = csv_quote(host.cpu_model) + ","
+                                     + csv_quote(host.kernel) + ","
+                                     + csv_quote(host.compiler) + ","
+                                     + csv_quote(host.root_version);
+    std::ofstream json{json_path};
+    json << "{\n"
+         << "  \"host\": {\n"
+         << "    \"cpu_model\": " << json_quote(host.cpu_model) << ",\n"
+         << "    \"kernel\": " << json_quote(host.kernel) << ",\n"
+         << "    \"compiler\": " << json_quote(host.compiler) << ",\n"
+         << "    \"root_version\": " << json_quote(host.root_version)
+         << "\n  },\n"
+         << "  \"num_bins\": " << config.num_bins << ",\n"
+         << "  \"num_iters\": " << config.num_iters << ",\n"
+         << "  \"batch_size\": " << BATCH_SIZE << ",\n"
+         << "  \"repetitions\": " << config.repetitions << ",\n"
+         << "  \"results\": [";
+    bool first_result = true;
+    for ( const auto& [placement, cpus]: placement_cpus ) {
+        for ( const auto& [strategy, time_strategy]: strategies ) {
+            if ( !selected(strategy) ) continue;
+            for ( const size_t num_threads: thread_counts ) {
+                // Configure threads and run the benchmark
+                parallel_config.num_threads = num_threads;
+                parallel_config.cpus.clear();
+                if ( !cpus.empty() ) {
+                    if ( num_threads > cpus.size() ) break;
+                    parallel_config.cpus.assign(cpus.begin(),
+                                                cpus.begin() + num_threads);
+                }
+                std::cout << "* " << strategy << ", " << placement << ", "
+                          << num_threads << " threads";
+                Timing timing;
+                try {
+                    timing = time_strategy();
+                } catch ( const std::exception& e ) {
+                    // e.g. the CPU set changed and a thread was not pinned
+                    std::cout << " -> failed: " << e.what() << std::endl;
+                    continue;
+                }
+                std::cout << " -> " << timing.median << " ns/iter (MAD "
+                          << timing.mad << ", min " << timing.min << ")"
+                          << std::endl;
+
+                // Record the results
+                csv << csv_host << "," << csv_quote(strategy) << ","
+                    << placement << "," << num_threads << ","
+                    << timing.median << "," << timing.mad << ","
+                    << timing.min << "," << timing.clock_ghz
+                    << std::endl;
+                json << (first_result ? "\n" : ",\n")
+                     << "    { \"strategy\": " << json_quote(strategy)
+                     << ", \"placement\": \"" << placement << "\""
+                     << ", \"threads\": " << num_threads
+                     << ", \"ns_per_iter\": " << timing.median
+                     << ", \"ns_per_iter_mad\": " << timing.mad
+                     << ", \"ns_per_iter_min\": " << timing.min
+                     << ", \"clock_ghz\": " << timing.clock_ghz << " }";
+                first_result = false;
+            }
+        }
+    }
+    json << "\n  ]\n}" << std::endl;
+
+    // Go back to the previous thread configuration
+    parallel_config = old_parallel_config;
+    std::cout << std::endl;
+}
+
+
+// Print command line usage
+void print_usage(const char* program)
+{
+    const BenchConfig defaults;
+    std::cout
+        << "Usage: " << program << " [options]\n"
+        << "\n"
+        << "Options:\n"
+        << "  --sections LIST         Benchmark sections to run, among\n"
+        << "                          scalar, batch, adaptive, aggregation,\n"
+        << "                          columnar, cache, scaling and atomic\n"
+        << "                          (default: all)\n"
+        << "  --filter TEXT           Only run strategies whose name contains\n"
+        << "                          TEXT\n"
+        << "  --iters N               Data points per benchmark (default: "
+        << defaults.num_iters << ")\n"
+        << "  --bins N                Bins of benchmark histograms (default: "
+        << defaults.num_bins << ")\n"
+        << "  --range MIN,MAX         Axis range of benchmark histograms\n"
+        << "                          (default: " << defaults.axis_range.first
+        << "," << defaults.axis_range.second << ")\n"
+        << "  --batch-sizes LIST      Batch sizes (default: depends on the\n"
+        << "                          section). ROOT's buffered fillers are\n"
+        << "                          only benchmarked for powers of 2 up\n"
+        << "                          to " << MAX_BATCH_SIZE << "\n"
+        << "  --sweep-bins LIST       Bin counts of the cache section\n"
+        << "  --threads N             Threads of parallel benchmarks\n"
+        << "                          (default: all CPU threads)\n"
+        << "  --scaling-threads LIST  Thread counts of the scaling section\n"
+        << "  --pin MODE              Pinning of parallel benchmark threads:\n"
+        << "                          none, compact (all hyperthreads of a\n"
+        << "                          core first) or spread (one thread per\n"
+        << "                          core first) (default: "
+        << defaults.pinning << ")\n"
+        << "  --warmup N              Untimed runs per benchmark (default: "
+        << defaults.warmup_runs << ")\n"
+        << "  --repetitions N         Timed runs per benchmark (default: "
+        << defaults.repetitions << ")\n"
+        << "  --counters on|off       Report performance counters (cycles,\n"
+        << "                          instructions, cache and branch misses,\n"
+        << "                          context switches) per data point,\n"
+        << "                          where available (default: "
+        << (defaults.counters ? "on" : "off") << ")\n"
+        << "  --coords MODE           Source of data points: rng (generated\n"
+        << "                          inside of the timed loops) or buffer\n"
+        << "                          (generated up front, only replayed\n"
+        << "                          inside of the timed loops) (default: "
+        << defaults.coords << ")\n"
+        << "  --distribution DIST     Data point distribution in buffer mode:\n"
+        << "                          uniform or gaussian (peaks over a flat\n"
+        << "                          background) (default: "
+        << defaults.distribution << ")\n"
+        << "  --buffer-coords N       Coordinates in the buffer, replayed in\n"
+        << "                          a loop (default: "
+        << defaults.buffer_coords << ")\n"
+        << "  --huge-pages on|off     Back the buffer with huge pages, if\n"
+        << "                          possible (default: "
+        << (defaults.huge_pages ? "on" : "off") << ")\n"
+        << "  --help                  Print this message\n"
+        << "\n"
+        << "LISTs are comma-separated, e.g. --batch-sizes 1,64,4096\n";
+}
+
+
+// Parse a positive (or, if allow_zero, nonnegative) integer from the command
+// line
+size_t parse_size(const std::string& arg, bool allow_zero = false)
+{
+    size_t end = 0;
+    unsigned long long value = 0;
+    try {
+        value = std::stoull(arg, &end);
+    } catch ( const std::exception& ) {}
+    if ( (end != arg.size()) || arg.empty() || (arg[0] == '-')
+         || ((value == 0) && !allow_zero) ) {
+        throw std::runtime_error("Expected a positive integer, got \""
+                                     + arg + "\"");
+    }
+    return value;
+}
+
+
+// Split a comma-separated list from the command line
+std::vector<std::string> split_list(const std::string& arg)
+{
+    std::vector<std::string> items;
+    size_t start = 0;
+    while ( true ) {
+        const size_t end = arg.find(',', start);
+        items.push_back(arg.substr(start, end - start));
+        if ( end == std::string::npos ) return items;
+        start = end + 1;
+    }
+}
+//
+std::vector<size_t> parse_size_list(const std::string& arg)
+{
+    std::vector<size_t> sizes;
+    for ( const auto& item: split_list(arg) ) {
+        sizes.push_back(parse_size(item));
+    }
+    return sizes;
+}
+
+
+// Parse command line arguments into config and parallel_config. Returns false
+// if the program should exit without running benchmarks.
+bool parse_args(int argc, char* argv[])
+{
+    const std::vector<std::string> all_sections = config.sections;
+    for ( int i = 1; i < argc; ++i ) {
+        const std::string option = argv[i];
+        if ( option == "--help" ) {
+            print_usage(argv[0]);
+            return false;
+        }
+        if ( i + 1 == argc ) {
+            throw std::runtime_error("Missing value for option " + option);
+        }
+        const std::string value = argv[++i];
+        if ( option == "--sections" ) {
+            config.sections = split_list(value);
+            for ( const auto& section: config.sections ) {
+                if ( std::find(all_sections.begin(), all_sections.end(),
+                               section) == all_sections.end() ) {
+                    throw std::runtime_error("Unknown section " + section);
+                }
+            }
+        } else if ( option == "--filter" ) {
+            config.filter = value;
+        } else if ( option == "--iters" ) {
+            config.num_iters = parse_size(value);
+        } else if ( option == "--bins" ) {
+            config.num_bins = parse_size(value);
+        } else if ( option == "--range" ) {
+            const auto bounds = split_list(value);
+            if ( bounds.size() != 2 ) {
+                throw std::runtime_error("Expected MIN,MAX axis range");
+            }
+            config.axis_range = { std::stof(bounds[0]), std::stof(bounds[1]) };
+            if ( !(config.axis_range.first < config.axis_range.second) ) {
+                throw std::runtime_error("Empty axis range");
+            }
+        } else if ( option == "--batch-sizes" ) {
+            config.batch_sizes = parse_size_list(value);
+        } else if ( option == "--sweep-bins" ) {
+            config.sweep_bins = parse_size_list(value);
+        } else if ( option == "--threads" ) {
+            parallel_config.num_threads = parse_size(value);
+        } else if ( option == "--scaling-threads" ) {
+            config.scaling_threads = parse_size_list(value);
+        } else if ( option == "--pin" ) {
+            if ( (value != "none") && (value != "compact")
+                 && (value != "spread") ) {
+                throw std::runtime_error("Unknown pinning mode " + value);
+            }
+            config.pinning = value;
+        } else if ( option == "--warmup" ) {
+            config.warmup_runs = parse_size(value, true);
+        } else if ( option == "--repetitions" ) {
+            config.repetitions = parse_size(value);
+        } else if ( option == "--counters" ) {
+            if ( (value != "on") && (value != "off") ) {
+                throw std::runtime_error("Expected on or off, got " + value);
+            }
+            config.counters = (value == "on");
+        } else if ( option == "--coords" ) {
+            if ( (value != "rng") && (value != "buffer") ) {
+                throw std::runtime_error("Unknown coordinate source " + value);
+            }
+            config.coords = value;
+        } else if ( option == "--distribution" ) {
+            if ( (value != "uniform") && (value != "gaussian") ) {
+                throw std::runtime_error("Unknown distribution " + value);
+            }
+            config.distribution = value;
+        } else if ( option == "--buffer-coords" ) {
+            config.buffer_coords = parse_size(value);
+        } else if ( option == "--huge-pages" ) {
+            if ( (value != "on") && (value != "off") ) {
+                throw std::runtime_error("Expected on or off, got " + value);
+            }
+            config.huge_pages = (value == "on");
+        } else {
+            throw std::runtime_error("Unknown option " + option);
+        }
+    }
+
+    // Non-uniform distributions are too expensive to sample inside of the
+    // timed loops, so they are only available in buffer mode
+    if ( (config.distribution != "uniform") && (config.coords != "buffer") ) {
+        throw std::runtime_error("--distribution requires --coords buffer");
+    }
+
+    // Set up thread pinning
+    if ( config.pinning != "none" ) {
+        const auto placements = cpu_placements();
+        const auto& cpus = (config.pinning == "compact") ? placements.compact
+                                                         : placements.spread;
+        if ( cpus.empty() ) {
+            throw std::runtime_error("Thread pinning is not supported here");
+        }
+        if ( parallel_config.num_threads > cpus.size() ) {
+            throw std::runtime_error("Cannot pin more threads than CPUs");
+        }
+        parallel_config.cpus.assign(cpus.begin(),
+                                    cpus.begin() + parallel_config.num_threads);
+    }
+    return true;
+}
+
+
+// Truth that a benchmark section was selected by the --sections option
+bool section_enabled(const std::string& section)
+{
+    return std::find(config.sections.begin(),
+                     config.sections.end(),
+                     section) != config.sections.end();
+}
+
+
+// Batch sizes to be used by a benchmark section, which default to
+// section_defaults unless the --batch-sizes option was used
+std::vector<size_t> section_batch_sizes(std::vector<size_t>&& section_defaults)
+{
+    return config.batch_sizes.empty() ? std::move(section_defaults)
+                                      : config.batch_sizes;
+}
+
+
+// Top-level benchmark logic
+int main(int argc, char* argv[])
+{
+    try {
+        if ( !parse_args(argc, argv) ) return 0;
+    } catch ( const std::exception& e ) {
+        std::cerr << "Error: " << e.what() << "\n" << std::endl;
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // Describe the host, in the format of FillBenchResults.txt
+    const HostInfo host = host_info();
+    std::cout << "---------------------------------------------" << std::endl
+              << "Measurements done on..." << std::endl
+              << "* " << host.cpu_model << std::endl
+              << "* " << host.kernel << std::endl
+              << "* ROOT " << host.root_version << std::endl
+              << "* " << host.compiler << std::endl
+              << "---------------------------------------------" << std::endl
+              << std::endl;
+
+    // Performance counters are optional, benchmarks run without them
+    if ( config.counters && !PerfCounters{}.available() ) {
+        std::cout << "NOTE: Performance counters are not available on this "
+                  << "host, only timings will be reported" << std::endl
+                  << std::endl;
+        config.counters = false;
+    }
+    if ( !ClockMonitor{}.available() ) {
+        std::cout << "NOTE: CPU cycles cannot be counted on this host, clock "
+                  << "frequencies will be reported as NaN" << std::endl
+                  << std::endl;
+    }
+
+    // Pre-generate the data points if requested
+    if ( config.coords == "buffer" ) {
+        auto buffer = std::make_unique<CoordBuffer>(config.buffer_coords,
+                                                    config.huge_pages);
+        generate_coords(*buffer);
+        std::cout << "Replaying " << buffer->size() << " pre-generated "
+                  << config.distribution << " coordinates ("
+                  << buffer->bytes() / (1024 * 1024) << " MiB, "
+                  << buffer->page_kind() << ")" << std::endl
+                  << std::endl;
+        coord_buffer = std::move(buffer);
+    }
+
+    if ( section_enabled("scalar") ) {
+        std::cout << "=== NO BATCHING ===" << std::endl;
+
+        // Unoptimized sequential Fill() pattern
+        //
+        // Pretty slow, as it goes through a layer of pImpl indirection...
+        //
+        bench("Scalar Fill()", scalar_fill);
+
+        std::cout << std::endl;
+    }
+
+    // Batch sizes from 1 to MAX_BATCH_SIZE
+    if ( section_enabled("batch") ) {
+        std::vector<size_t> all_batch_sizes;
+        for ( size_t size = 1; size <= MAX_BATCH_SIZE; size *= 2 ) {
+            all_batch_sizes.push_back(size);
+        }
+        for ( size_t batch_size:
+                  section_batch_sizes(std::move(all_batch_sizes)) ) {
+            batch_benches(batch_size);
+        }
+    }
+
+    // Buffer size can also be tuned at runtime
+    if ( section_enabled("adaptive") ) adaptive_benches();
+
+    // Pre-aggregation depends on both the batch size and the number of bins
+    if ( section_enabled("aggregation") ) {
+        for ( size_t batch_size: section_batch_sizes({64, 1024, 16384}) ) {
+            aggregation_benches(batch_size);
+        }
+    }
+
+    // Columnar input avoids repacking coordinates
+    if ( section_enabled("columnar") ) {
+        for ( size_t batch_size: section_batch_sizes({1024}) ) {
+            columnar_benches(batch_size);
+        }
+    }
+
+    // Performance depends on where the histogram fits in the cache hierarchy
+    if ( section_enabled("cache") ) {
+        cache_sweep(section_batch_sizes({1, 16, 256, 4096, 65536}));
+    }
+
+    // Parallel strategies are best compared across thread counts
+    if ( section_enabled("scaling") ) {
+        scaling_sweep(host, "fillBench_scaling.csv", "fillBench_scaling.json");
+    }
+
+    // Atomic bins are best compared under varying bin contention
+    if ( section_enabled("atomic") ) {
+        atomic_benches(config.num_bins);
+        atomic_benches(NUM_CONTENDED_BINS);
+    }
+
+    return 0;
+}
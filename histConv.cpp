@@ -1,5 +1,7 @@
 #include "histConv.hpp"
 
+#include "TROOT.h"
+
 
 namespace detail
 {
@@ -51,6 +53,170 @@ namespace detail
   }
 
 
+  AxisLayout describe_equidistant_axis(const RExp::RAxisEquidistant& axis) {
+    AxisLayout layout;
+    layout.kind = AxisKind::Equidistant;
+    layout.num_bins = axis.GetNBinsNoOver();
+    layout.minimum = axis.GetMinimum();
+    layout.maximum = axis.GetMaximum();
+    return layout;
+  }
+
+
+  AxisLayout describe_irregular_axis(const RExp::RAxisIrregular& axis) {
+    AxisLayout layout;
+    layout.kind = AxisKind::Irregular;
+    layout.num_bins = axis.GetNBinsNoOver();
+    layout.minimum = axis.GetMinimum();
+    layout.maximum = axis.GetMaximum();
+    layout.bin_borders = axis.GetBinBorders();
+    return layout;
+  }
+
+
+  AxisLayout describe_axis(const RExp::RAxisBase& axis) {
+    // Is this an equidistant axis?
+    const auto* eq_axis_ptr =
+      dynamic_cast<const RExp::RAxisEquidistant*>(&axis);
+    if (eq_axis_ptr != nullptr) {
+      AxisLayout layout = describe_equidistant_axis(*eq_axis_ptr);
+
+      // Is it also labeled?
+      const auto* lbl_axis_ptr =
+        dynamic_cast<const RExp::RAxisLabels*>(eq_axis_ptr);
+      if (lbl_axis_ptr != nullptr) {
+        layout.kind = AxisKind::Labels;
+        for (const auto label: lbl_axis_ptr->GetBinLabels()) {
+          layout.labels.emplace_back(label);
+        }
+      }
+      return layout;
+    }
+
+    // Is this an irregular axis?
+    const auto* irr_axis_ptr =
+      dynamic_cast<const RExp::RAxisIrregular*>(&axis);
+    if (irr_axis_ptr != nullptr) {
+      return describe_irregular_axis(*irr_axis_ptr);
+    }
+
+    // As of ROOT 6.18.0, there should be no other axis kind, so
+    // reaching this point indicates a bug in the code.
+    throw std::runtime_error("Unsupported histogram axis type");
+  }
+
+
+  std::vector<Double_t> root6_bin_centers(const AxisLayout& layout) {
+    // Like TAxis::GetBinCenter, we treat under- and overflow bins as if
+    // they had the average bin width, even on irregular axes
+    const Int_t num_bins = layout.num_bins;
+    const Double_t avg_width = (layout.maximum - layout.minimum) / num_bins;
+    std::vector<Double_t> centers(num_bins + 2);
+    for (Int_t bin = 0; bin < num_bins + 2; ++bin) {
+      centers[bin] = layout.minimum + (bin - 1) * avg_width + 0.5 * avg_width;
+    }
+
+    // Regular bins of irregular axes are centered between their borders
+    if (layout.kind == AxisKind::Irregular) {
+      const auto& borders = layout.bin_borders;
+      for (Int_t bin = 1; bin <= num_bins; ++bin) {
+        const Double_t width = borders[bin] - borders[bin-1];
+        centers[bin] = borders[bin-1] + 0.5 * width;
+      }
+    }
+    return centers;
+  }
+
+
+  bool axis_matches(const AxisLayout& layout, const RExp::RAxisBase& axis) {
+    if ((axis.GetNBinsNoOver() != layout.num_bins)
+        || (axis.GetMinimum() != layout.minimum)
+        || (axis.GetMaximum() != layout.maximum)) {
+      return false;
+    }
+    switch (layout.kind) {
+    case AxisKind::Equidistant:
+      return true;
+
+    case AxisKind::Irregular:
+      return static_cast<const RExp::RAxisIrregular&>(axis).GetBinBorders()
+               == layout.bin_borders;
+
+    case AxisKind::Labels: {
+      const auto labels =
+        static_cast<const RExp::RAxisLabels&>(axis).GetBinLabels();
+      return std::equal(labels.cbegin(), labels.cend(),
+                        layout.labels.cbegin(), layout.labels.cend());
+    }
+    }
+
+    throw std::runtime_error("There's a bug in this switch, please fix it.");
+  }
+
+
+  void check_axis_layout(const AxisLayout& layout, TAxis& axis) {
+    // All axis kinds must agree on the number of bins
+    if (axis.GetNbins() != layout.num_bins) {
+      throw std::runtime_error("Output histogram axis has "
+                               + std::to_string(axis.GetNbins())
+                               + " bins, expected "
+                               + std::to_string(layout.num_bins));
+    }
+
+    // Beyond that, bin borders must match
+    switch (layout.kind) {
+    case AxisKind::Equidistant:
+    case AxisKind::Labels:
+      if (axis.IsVariableBinSize()
+          || (axis.GetXmin() != layout.minimum)
+          || (axis.GetXmax() != layout.maximum)) {
+        throw std::runtime_error("Output histogram axis is not equidistant "
+                                 "with the expected range");
+      }
+      if (layout.kind == AxisKind::Equidistant) return;
+
+      // Labeled axes must also carry the same bin labels
+      if (axis.GetLabels() == nullptr) {
+        throw std::runtime_error("Output histogram axis should be labeled");
+      }
+      for (size_t bin = 0; bin < layout.labels.size(); ++bin) {
+        if (layout.labels[bin] != axis.GetBinLabel(bin + 1)) {
+          throw std::runtime_error("Output histogram axis has wrong labels");
+        }
+      }
+      return;
+
+    case AxisKind::Irregular: {
+      if (!axis.IsVariableBinSize()) {
+        throw std::runtime_error("Output histogram axis should be irregular");
+      }
+      const auto& borders = *axis.GetXbins();
+      for (int i = 0; i < borders.fN; ++i) {
+        if (borders[i] != layout.bin_borders[i]) {
+          throw std::runtime_error("Output histogram axis has wrong borders");
+        }
+      }
+      return;
+    }
+    }
+
+    throw std::runtime_error("There's a bug in this switch, please fix it.");
+  }
+
+
+  void setup_axis_labels(TAxis& dest, const AxisLayout& layout) {
+    if (layout.kind == AxisKind::Labels) {
+      dest.SetNoAlphanumeric(false);
+      for (size_t bin = 0; bin < layout.labels.size(); ++bin) {
+        // ROOT 6 bin labels are numbered from 1, like regular bins
+        dest.SetBinLabel(bin + 1, layout.labels[bin].c_str());
+      }
+    } else {
+      dest.SetNoAlphanumeric(true);
+    }
+  }
+
+
   void setup_axis_base(TAxis& dest, const RExp::RAxisBase& src) {
     // Propagate axis title
     dest.SetTitle(src.GetTitle().c_str());
@@ -60,21 +226,359 @@ namespace detail
   }
 
 
-  template TH1C convert_hist(const RExp::RHist<1, char>&, const char*);
-  template TH1S convert_hist(const RExp::RHist<1, Short_t>&, const char*);
-  template TH1I convert_hist(const RExp::RHist<1, Int_t>&, const char*);
-  template TH1F convert_hist(const RExp::RHist<1, Float_t>&, const char*);
-  template TH1D convert_hist(const RExp::RHist<1, Double_t>&, const char*);
+  RExp::RAxisConfig get_root7_axis_config(const TAxis& axis) {
+    const std::string title = axis.GetTitle();
+    const Int_t num_bins = axis.GetNbins();
+
+    // Is this a labeled axis?
+    if (axis.GetLabels() != nullptr) {
+      std::vector<std::string> labels;
+      for (Int_t bin = 1; bin <= num_bins; ++bin) {
+        labels.emplace_back(axis.GetBinLabel(bin));
+      }
+      return RExp::RAxisConfig(title, std::move(labels));
+    }
+
+    // Is this an irregular axis?
+    if (axis.IsVariableBinSize()) {
+      const auto& borders = *axis.GetXbins();
+      return RExp::RAxisConfig(
+        title,
+        std::vector<double>(borders.GetArray(),
+                            borders.GetArray() + borders.GetSize())
+      );
+    }
+
+    // Otherwise, this is an equidistant axis, which may be growable
+    if (axis.CanExtend()) {
+      return RExp::RAxisConfig(title,
+                               RExp::RAxisConfig::Grow,
+                               num_bins,
+                               axis.GetXmin(),
+                               axis.GetXmax());
+    } else {
+      return RExp::RAxisConfig(title,
+                               num_bins,
+                               axis.GetXmin(),
+                               axis.GetXmax());
+    }
+  }
+
+
+  std::mutex& root6_global_state_mutex() {
+    static std::mutex mutex;
+    return mutex;
+  }
+
+
+  ThreadPool::ThreadPool(unsigned num_workers) {
+    m_workers.reserve(num_workers);
+    for (unsigned worker = 0; worker < num_workers; ++worker) {
+      m_workers.emplace_back([this] { run_worker(); });
+    }
+  }
+
+
+  ThreadPool::~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock{m_mutex};
+      m_stopping = true;
+    }
+    m_loop_added.notify_all();
+    for (auto& worker: m_workers) {
+      worker.join();
+    }
+  }
+
+
+  void ThreadPool::parallel_for(size_t num_tasks,
+                                unsigned max_threads,
+                                const std::function<void(size_t)>& task) {
+    // Advertise the loop to the worker threads, if they can help
+    Loop loop{task, num_tasks, std::max(max_threads, 1u)};
+    const size_t num_helpers = std::min({size_t(loop.max_threads - 1),
+                                         num_tasks,
+                                         m_workers.size()});
+    if (num_helpers > 0) {
+      {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_loops.push_back(&loop);
+      }
+      for (size_t helper = 0; helper < num_helpers; ++helper) {
+        m_loop_added.notify_one();
+      }
+    }
+
+    // Do our share of the work, then wait for the helpers to finish theirs
+    run_tasks(loop);
+    std::unique_lock<std::mutex> lock{m_mutex};
+    if (num_helpers > 0) {
+      m_loops.erase(std::find(m_loops.begin(), m_loops.end(), &loop));
+    }
+    m_task_done.wait(lock, [&] {
+      return (loop.num_done == loop.num_tasks) && (loop.num_threads == 0);
+    });
+    if (loop.error) std::rethrow_exception(loop.error);
+  }
+
+
+  void ThreadPool::run_tasks(Loop& loop) {
+    size_t num_done = 0;
+    std::exception_ptr error;
+    size_t task_idx;
+    while ((task_idx = loop.next_task.fetch_add(1, std::memory_order_relaxed))
+           < loop.num_tasks) {
+      try {
+        loop.task(task_idx);
+      } catch (...) {
+        if (!error) error = std::current_exception();
+      }
+      ++num_done;
+    }
+
+    // This is the last time that this thread touches the loop, which the
+    // parallel_for caller may destroy as soon as the lock is released
+    std::lock_guard<std::mutex> lock{m_mutex};
+    loop.num_done += num_done;
+    loop.num_threads -= 1;
+    if (error && !loop.error) loop.error = error;
+    if ((loop.num_done == loop.num_tasks) && (loop.num_threads == 0)) {
+      m_task_done.notify_all();
+    }
+  }
+
+
+  ThreadPool::Loop* ThreadPool::find_loop() const {
+    for (Loop* loop: m_loops) {
+      if ((loop->num_threads < loop->max_threads)
+          && (loop->next_task.load(std::memory_order_relaxed)
+              < loop->num_tasks)) {
+        return loop;
+      }
+    }
+    return nullptr;
+  }
+
+
+  void ThreadPool::run_worker() {
+    std::unique_lock<std::mutex> lock{m_mutex};
+    while (true) {
+      Loop* loop = nullptr;
+      m_loop_added.wait(lock, [&] {
+        loop = find_loop();
+        return m_stopping || (loop != nullptr);
+      });
+      if (loop == nullptr) return;
+      loop->num_threads += 1;
+      lock.unlock();
+      run_tasks(*loop);
+      lock.lock();
+    }
+  }
+
+
+  ThreadPool& conversion_thread_pool() {
+    static ThreadPool pool{std::max(std::thread::hardware_concurrency(), 1u)
+                           - 1};
+    return pool;
+  }
+
+
+  template TH1C convert_hist(const RExp::RHist<1, char>&,
+                             const char*,
+                             const Root6ConversionOptions&);
+  template TH1S convert_hist(const RExp::RHist<1, Short_t>&,
+                             const char*,
+                             const Root6ConversionOptions&);
+  template TH1I convert_hist(const RExp::RHist<1, Int_t>&,
+                             const char*,
+                             const Root6ConversionOptions&);
+  template TH1F convert_hist(const RExp::RHist<1, Float_t>&,
+                             const char*,
+                             const Root6ConversionOptions&);
+  template TH1D convert_hist(const RExp::RHist<1, Double_t>&,
+                             const char*,
+                             const Root6ConversionOptions&);
+  //
+  template TH2C convert_hist(const RExp::RHist<2, Char_t>&,
+                             const char*,
+                             const Root6ConversionOptions&);
+  template TH2S convert_hist(const RExp::RHist<2, Short_t>&,
+                             const char*,
+                             const Root6ConversionOptions&);
+  template TH2I convert_hist(const RExp::RHist<2, Int_t>&,
+                             const char*,
+                             const Root6ConversionOptions&);
+  template TH2F convert_hist(const RExp::RHist<2, Float_t>&,
+                             const char*,
+                             const Root6ConversionOptions&);
+  template TH2D convert_hist(const RExp::RHist<2, Double_t>&,
+                             const char*,
+                             const Root6ConversionOptions&);
+  //
+  template TH3C convert_hist(const RExp::RHist<3, Char_t>&,
+                             const char*,
+                             const Root6ConversionOptions&);
+  template TH3S convert_hist(const RExp::RHist<3, Short_t>&,
+                             const char*,
+                             const Root6ConversionOptions&);
+  template TH3I convert_hist(const RExp::RHist<3, Int_t>&,
+                             const char*,
+                             const Root6ConversionOptions&);
+  template TH3F convert_hist(const RExp::RHist<3, Float_t>&,
+                             const char*,
+                             const Root6ConversionOptions&);
+  template TH3D convert_hist(const RExp::RHist<3, Double_t>&,
+                             const char*,
+                             const Root6ConversionOptions&);
+
+  template void refresh_hist(const RExp::RHist<1, Char_t>&,
+                             TH1C&,
+                             const Root6ConversionOptions&);
+  template void refresh_hist(const RExp::RHist<1, Short_t>&,
+                             TH1S&,
+                             const Root6ConversionOptions&);
+  template void refresh_hist(const RExp::RHist<1, Int_t>&,
+                             TH1I&,
+                             const Root6ConversionOptions&);
+  template void refresh_hist(const RExp::RHist<1, Float_t>&,
+                             TH1F&,
+                             const Root6ConversionOptions&);
+  template void refresh_hist(const RExp::RHist<1, Double_t>&,
+                             TH1D&,
+                             const Root6ConversionOptions&);
+  //
+  template void refresh_hist(const RExp::RHist<2, Char_t>&,
+                             TH2C&,
+                             const Root6ConversionOptions&);
+  template void refresh_hist(const RExp::RHist<2, Short_t>&,
+                             TH2S&,
+                             const Root6ConversionOptions&);
+  template void refresh_hist(const RExp::RHist<2, Int_t>&,
+                             TH2I&,
+                             const Root6ConversionOptions&);
+  template void refresh_hist(const RExp::RHist<2, Float_t>&,
+                             TH2F&,
+                             const Root6ConversionOptions&);
+  template void refresh_hist(const RExp::RHist<2, Double_t>&,
+                             TH2D&,
+                             const Root6ConversionOptions&);
+  //
+  template void refresh_hist(const RExp::RHist<3, Char_t>&,
+                             TH3C&,
+                             const Root6ConversionOptions&);
+  template void refresh_hist(const RExp::RHist<3, Short_t>&,
+                             TH3S&,
+                             const Root6ConversionOptions&);
+  template void refresh_hist(const RExp::RHist<3, Int_t>&,
+                             TH3I&,
+                             const Root6ConversionOptions&);
+  template void refresh_hist(const RExp::RHist<3, Float_t>&,
+                             TH3F&,
+                             const Root6ConversionOptions&);
+  template void refresh_hist(const RExp::RHist<3, Double_t>&,
+                             TH3D&,
+                             const Root6ConversionOptions&);
+
+
+  template Root7OutputHist<1, Char_t>
+  convert_hist_to_root7(const TH1C&);
+  template Root7OutputHist<1, Short_t>
+  convert_hist_to_root7(const TH1S&);
+  template Root7OutputHist<1, Int_t>
+  convert_hist_to_root7(const TH1I&);
+  template Root7OutputHist<1, Float_t>
+  convert_hist_to_root7(const TH1F&);
+  template Root7OutputHist<1, Double_t>
+  convert_hist_to_root7(const TH1D&);
   //
-  template TH2C convert_hist(const RExp::RHist<2, Char_t>&, const char*);
-  template TH2S convert_hist(const RExp::RHist<2, Short_t>&, const char*);
-  template TH2I convert_hist(const RExp::RHist<2, Int_t>&, const char*);
-  template TH2F convert_hist(const RExp::RHist<2, Float_t>&, const char*);
-  template TH2D convert_hist(const RExp::RHist<2, Double_t>&, const char*);
+  template Root7OutputHist<2, Char_t>
+  convert_hist_to_root7(const TH2C&);
+  template Root7OutputHist<2, Short_t>
+  convert_hist_to_root7(const TH2S&);
+  template Root7OutputHist<2, Int_t>
+  convert_hist_to_root7(const TH2I&);
+  template Root7OutputHist<2, Float_t>
+  convert_hist_to_root7(const TH2F&);
+  template Root7OutputHist<2, Double_t>
+  convert_hist_to_root7(const TH2D&);
   //
-  template TH3C convert_hist(const RExp::RHist<3, Char_t>&, const char*);
-  template TH3S convert_hist(const RExp::RHist<3, Short_t>&, const char*);
-  template TH3I convert_hist(const RExp::RHist<3, Int_t>&, const char*);
-  template TH3F convert_hist(const RExp::RHist<3, Float_t>&, const char*);
-  template TH3D convert_hist(const RExp::RHist<3, Double_t>&, const char*);
+  template Root7OutputHist<3, Char_t>
+  convert_hist_to_root7(const TH3C&);
+  template Root7OutputHist<3, Short_t>
+  convert_hist_to_root7(const TH3S&);
+  template Root7OutputHist<3, Int_t>
+  convert_hist_to_root7(const TH3I&);
+  template Root7OutputHist<3, Float_t>
+  convert_hist_to_root7(const TH3F&);
+  template Root7OutputHist<3, Double_t>
+  convert_hist_to_root7(const TH3D&);
+}
+
+
+HistConversionCache::HistConversionCache()
+  : m_impl{std::make_unique<Impl>()}
+{}
+
+
+HistConversionCache::~HistConversionCache() = default;
+
+
+size_t HistConversionCache::hits() const {
+  return m_impl->hits.load(std::memory_order_relaxed);
+}
+
+
+size_t HistConversionCache::misses() const {
+  return m_impl->misses.load(std::memory_order_relaxed);
+}
+
+
+void HistConversionCache::clear() {
+  std::lock_guard<std::mutex> lock{m_impl->mutex};
+  std::get<0>(m_impl->plans).clear();
+  std::get<1>(m_impl->plans).clear();
+  std::get<2>(m_impl->plans).clear();
+  std::get<0>(m_impl->sources).clear();
+  std::get<1>(m_impl->sources).clear();
+  std::get<2>(m_impl->sources).clear();
+}
+
+
+std::vector<Root6ConversionResult>
+into_root6_hists(const std::vector<Root6ConversionJob>& jobs,
+                 unsigned num_threads,
+                 const Root6ConversionOptions& options) {
+  // ROOT 6 must be told that it is going to be used from multiple threads
+  // (this notably makes the current directory thread-local)
+  ROOT::EnableThreadSafety();
+
+  // Results are stored by job index, so their order does not depend on the
+  // order in which threads process the jobs
+  std::vector<Root6ConversionResult> results(jobs.size());
+
+  // Jobs run on the thread pool shared by all conversions. Threads fetch
+  // jobs dynamically, so that a few expensive conversions do not leave the
+  // other threads idle, and the bin transfers of individual conversions
+  // (see options.num_threads) draw from the same pool, so that nesting
+  // both levels of parallelism does not oversubscribe the CPU.
+  auto& pool = detail::conversion_thread_pool();
+  if (num_threads == 0) num_threads = pool.max_threads();
+  pool.parallel_for(
+    jobs.size(),
+    num_threads,
+    [&](size_t job_idx) {
+      auto& result = results[job_idx];
+      try {
+        // Jobs detach their histogram from the current ROOT directory, which
+        // is shared by all threads, while they hold the ROOT 6 global state
+        // lock. The caller owns the results.
+        result.hist = jobs[job_idx].convert(options);
+      } catch (const std::exception& e) {
+        result.hist.reset();
+        result.error = e.what();
+      }
+    }
+  );
+  return results;
 }
@@ -7,17 +7,32 @@
 // See histConv.hpp.dcl for the basic declarations, which may be all you need.
 
 #include "histConv.hpp.dcl"
+#include "histStats.hpp"
 
 #include "ROOT/RAxis.hxx"
 #include "ROOT/RHist.hxx"
 #include "ROOT/RHistImpl.hxx"
 #include "TAxis.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
+#include <cmath>
+#include <condition_variable>
 #include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <tuple>
+#include <type_traits>
+#include <typeindex>
+#include <typeinfo>
 #include <utility>
+#include <vector>
 
 
 namespace detail
@@ -172,128 +187,670 @@ namespace detail
   TAxis& get_root6_axis(TH2& hist, size_t idx);
   TAxis& get_root6_axis(TH3& hist, size_t idx);
 
-  // ROOT 7-like GetBinIndexFromLocalBins for ROOT 6
-  inline Int_t get_bin_idx_from_local_root6(const TH1& hist,
-                                            const std::array<Int_t, 1>& bins) {
-    return hist.GetBin(bins[0]);
-  }
-  inline Int_t get_bin_idx_from_local_root6(const TH2& hist,
-                                            const std::array<Int_t, 2>& bins) {
-    return hist.GetBin(bins[0], bins[1]);
-  }
-  inline Int_t get_bin_idx_from_local_root6(const TH3& hist,
-                                            const std::array<Int_t, 3>& bins) {
-    return hist.GetBin(bins[0], bins[1], bins[2]);
-  }
-
   // Transfer histogram axis settings which are common to all axis
   // configurations (currently equidistant, growable, irregular and labels)
   void setup_axis_base(TAxis& dest, const RExp::RAxisBase& src);
 
+  // Build the ROOT 7 configuration of a ROOT 6 axis
+  RExp::RAxisConfig get_root7_axis_config(const TAxis& axis);
+  //
+  template <size_t... AXES>
+  std::array<RExp::RAxisConfig, sizeof...(AXES)>
+  get_root7_axis_configs(const TH1& hist, std::index_sequence<AXES...>) {
+    const std::array<const TAxis*, 3> axes{hist.GetXaxis(),
+                                           hist.GetYaxis(),
+                                           hist.GetZaxis()};
+    return {get_root7_axis_config(*axes[AXES])...};
+  }
 
-  // === MAIN CONVERSION FUNCTIONS ===
+  // Mutex protecting the ROOT 6 global state that is touched when building
+  // a THx, such as the current directory's list of histograms. It must be
+  // held during THx construction when converting from multiple threads.
+  std::mutex& root6_global_state_mutex();
 
   // Shorthand for an excessively long name
   template <int DIMS>
   using RHistImplPABase = RExp::Detail::RHistImplPrecisionAgnosticBase<DIMS>;
 
+
+  // === THREAD POOL SHARED BY ALL CONVERSIONS ===
+
+  // Persistent pool of worker threads, which runs parallel loops
+  //
+  // Spawning threads for every conversion would add a fixed cost that
+  // dwarfs the transfer time of all but the largest histograms, so all
+  // parallel conversion work goes through a pool of threads that is only
+  // started once.
+  //
+  // The thread calling parallel_for participates in its own loop, and idle
+  // worker threads steal iterations from whichever loops have some left.
+  // Loops may be nested (e.g. a batch of conversions, each of which splits
+  // its bin transfer across threads) without using more threads than the
+  // pool has, and without deadlocking: a loop can always be finished by its
+  // calling thread alone.
+  //
+  class ThreadPool
+  {
+  public:
+    // Start a pool with a certain number of worker threads
+    explicit ThreadPool(unsigned num_workers);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Stop the worker threads, which must not be running any loop
+    ~ThreadPool();
+
+    // Maximal number of threads that can run a loop (workers + caller)
+    unsigned max_threads() const { return m_workers.size() + 1; }
+
+    // Run task(0) to task(num_tasks-1) on up to max_threads threads,
+    // including the calling thread, and wait for them to complete. If some
+    // tasks throw, the first exception is rethrown once all tasks are done.
+    void parallel_for(size_t num_tasks,
+                      unsigned max_threads,
+                      const std::function<void(size_t)>& task);
+
+  private:
+    // Parallel loop, which lives on the stack of the parallel_for caller
+    struct Loop
+    {
+      Loop(const std::function<void(size_t)>& task_,
+           size_t num_tasks_,
+           unsigned max_threads_)
+        : task{task_}, num_tasks{num_tasks_}, max_threads{max_threads_}
+      {}
+
+      const std::function<void(size_t)>& task;
+      const size_t num_tasks;
+      const unsigned max_threads;
+
+      // Index of the next task to be run
+      std::atomic<size_t> next_task = 0;
+
+      // Number of tasks that were run, and of threads that are running
+      // tasks, protected by m_mutex
+      size_t num_done = 0;
+      unsigned num_threads = 1;
+
+      // First exception thrown by a task, protected by m_mutex
+      std::exception_ptr error;
+    };
+
+    // Run tasks from a loop until there are none left, and record that
+    // they were run (must be called without holding m_mutex)
+    void run_tasks(Loop& loop);
+
+    // Find a loop that a worker thread can participate in, if any
+    Loop* find_loop() const;
+
+    // Worker thread main loop
+    void run_worker();
+
+    // Loops which may have tasks left, for workers to pick from
+    std::vector<Loop*> m_loops;
+    bool m_stopping = false;
+
+    // Synchronization between the worker threads and parallel_for callers
+    std::mutex m_mutex;
+    std::condition_variable m_loop_added;
+    std::condition_variable m_task_done;
+
+    std::vector<std::thread> m_workers;
+  };
+
+  // Thread pool used by all conversions, with one thread per hardware thread
+  ThreadPool& conversion_thread_pool();
+
+
+  // === PRECOMPUTED ROOT 7 -> ROOT 6 BIN MAPPING ===
+
+  // Run of ROOT 7 bins which maps into an arithmetic progression of ROOT 6
+  // bins, e.g. a row of non-overflow bins along one axis.
+  template <int DIMS>
+  struct BinRun
+  {
+    // First ROOT 7 global bin index of the run, and increment to the next one
+    // (ROOT 7 numbers regular bins upwards from 1 and overflow bins downwards
+    // from -1, so this is either +1 or -1)
+    int src_first;
+    int src_stride;
+
+    // First ROOT 6 global bin index of the run, and increment to the next one
+    Int_t dest_first;
+    Int_t dest_stride;
+
+    // ROOT 6 local bin coordinates of the first bin, and axis along which the
+    // run progresses (subsequent bins only differ on that coordinate)
+    std::array<Int_t, DIMS> dest_first_local;
+    int axis;
+
+    // Number of bins in the run
+    int length;
+  };
+
+  // Mapping from ROOT 7 global bin indices to ROOT 6 global bin indices
+  //
+  // Going from one indexing convention to the other bin by bin, through the
+  // type-erased RHistImpl interface, is expensive. So we do it once for a
+  // given axis configuration, and record the resulting permutation as a list
+  // of bin runs that data transfers can then go through with tight loops.
+  //
+  // The plan also keeps the axis layout that it was computed from, which
+  // holds the resolved axis kinds and the per-axis ROOT 6 histogram
+  // constructor parameters, so that a cached plan is all it takes to build
+  // the output histogram.
+  //
+  template <int DIMS>
+  class ConversionPlan
+  {
+  public:
+    // Compute the bin mapping of a ROOT 7 histogram, given its axis layout
+    // and the number of regular and under/overflow bins of its statistics.
+    //
+    // SrcImpl may be RHistImplPABase<DIMS> or any class deriving from it.
+    // Passing the concrete RHistImpl type lets the compiler devirtualize the
+    // per-bin GetLocalBins calls.
+    //
+    template <class SrcImpl>
+    ConversionPlan(const SrcImpl& src_impl,
+                   const HistLayout<DIMS>& layout,
+                   int num_regular_bins,
+                   int num_overflow_bins);
+
+    // Axis layout of the histograms that the plan applies to
+    const HistLayout<DIMS>& layout() const { return m_layout; }
+
+    // Runs of bins, in ROOT 7 bin iteration order (regular bins first, then
+    // under- and overflow bins)
+    const std::vector<BinRun<DIMS>>& runs() const { return m_runs; }
+
+    // Centers of the ROOT 6 bins of some axis, indexed by local bin index
+    // (these are the coordinates that TH1::GetStats would use)
+    const std::vector<Double_t>& bin_centers(int axis) const {
+      return m_bin_centers[axis];
+    }
+
+    // Total number of bins covered by the plan
+    size_t num_bins() const { return m_num_bins; }
+
+    // Invoke a callback on the parts of runs which cover a range of bins,
+    // given as [begin, end) positions in plan iteration order. The callback
+    // receives a run, the offset of the first bin within it, and a length.
+    template <typename RunPartCallback>
+    void for_each_run_part(size_t begin,
+                           size_t end,
+                           RunPartCallback&& run_part_callback) const {
+      const auto first_run_it =
+        std::upper_bound(m_run_starts.cbegin(), m_run_starts.cend(), begin)
+        - 1;
+      for (size_t run_idx = first_run_it - m_run_starts.cbegin();
+           (run_idx < m_runs.size()) && (m_run_starts[run_idx] < end);
+           ++run_idx) {
+        const size_t run_start = m_run_starts[run_idx];
+        const auto& run = m_runs[run_idx];
+        const size_t part_begin = std::max(begin, run_start);
+        const size_t part_end = std::min(end, run_start + run.length);
+        run_part_callback(run,
+                          int(part_begin - run_start),
+                          int(part_end - part_begin));
+      }
+    }
+
+    // Invoke a callback with the index of each input ROOT 7 bin and that of
+    // the matching bin in the output ROOT 6 histogram
+    template <typename BinIndicesCallback>
+    void for_each_bin(BinIndicesCallback&& bin_indices_callback) const {
+      for (const auto& run: m_runs) {
+        int src_bin = run.src_first;
+        Int_t dest_bin = run.dest_first;
+        for (int i = 0; i < run.length; ++i) {
+          bin_indices_callback(src_bin, dest_bin);
+          src_bin += run.src_stride;
+          dest_bin += run.dest_stride;
+        }
+      }
+    }
+
+  private:
+    // Append a bin to the plan, extending the last run if possible
+    void push_bin(int src_bin, int src_stride,
+                  const std::array<Int_t, DIMS>& dest_local);
+
+    // Axis layout, see layout()
+    HistLayout<DIMS> m_layout;
+
+    // ROOT 6 global bin index increment associated with each local axis
+    std::array<Int_t, DIMS> m_dest_strides;
+
+    // Runs of bins that make up the mapping, and position of the first bin
+    // of each run in plan iteration order
+    std::vector<BinRun<DIMS>> m_runs;
+    std::vector<size_t> m_run_starts;
+
+    // Total number of bins
+    size_t m_num_bins = 0;
+
+    // ROOT 6 bin centers of each axis
+    std::array<std::vector<Double_t>, DIMS> m_bin_centers;
+  };
+
+
+  template <int DIMS>
+  template <class SrcImpl>
+  ConversionPlan<DIMS>::ConversionPlan(const SrcImpl& src_impl,
+                                       const HistLayout<DIMS>& layout,
+                                       int num_regular_bins,
+                                       int num_overflow_bins)
+    : m_layout(layout)
+  {
+    // Record the ROOT 6 bin centers of each axis, including under- and
+    // overflow bins, for the purpose of statistics computations
+    for (int dim = 0; dim < DIMS; ++dim) {
+      m_bin_centers[dim] = root6_bin_centers(layout[dim]);
+    }
+
+    // ROOT 6 histograms store their bins in X-major order, with the
+    // under- and overflow bins of each axis at both ends of its bin range.
+    Int_t stride = 1;
+    std::array<Int_t, DIMS> dest_overflow_local;
+    for (int dim = 0; dim < DIMS; ++dim) {
+      m_dest_strides[dim] = stride;
+      stride *= layout[dim].num_bins + 2;
+      dest_overflow_local[dim] = layout[dim].num_bins + 1;
+    }
+
+    // This is how we turn a ROOT 7 global bin index into ROOT 6 local bins
+    auto to_dest_local = [&](const int src_bin) -> std::array<Int_t, DIMS> {
+      // Convert to per-axis local bin coordinates
+      const auto src_local = src_impl.GetLocalBins(src_bin);
+
+      // Move to the ROOT 6 under/overflow bin indexing convention
+      std::array<Int_t, DIMS> dest_local;
+      for (int dim = 0; dim < DIMS; ++dim) {
+        if (src_local[dim] == -1) {
+          dest_local[dim] = 0;
+        } else if (src_local[dim] == -2) {
+          dest_local[dim] = dest_overflow_local[dim];
+        } else {
+          dest_local[dim] = src_local[dim];
+        }
+      }
+      return dest_local;
+    };
+
+    // Go through every input bin, in ROOT 7 bin iteration order
+    for (int src_bin = 1; src_bin <= num_regular_bins; ++src_bin) {
+      push_bin(src_bin, 1, to_dest_local(src_bin));
+    }
+    for (int src_bin = -1; src_bin >= -num_overflow_bins; --src_bin) {
+      push_bin(src_bin, -1, to_dest_local(src_bin));
+    }
+  }
+
+
+  template <int DIMS>
+  void ConversionPlan<DIMS>::push_bin(int src_bin,
+                                      int src_stride,
+                                      const std::array<Int_t, DIMS>& dest_local)
+  {
+    ++m_num_bins;
+
+    // Can this bin be appended to the last run?
+    if (!m_runs.empty()) {
+      auto& run = m_runs.back();
+      const bool src_contiguous =
+        (src_stride == run.src_stride)
+        && (src_bin == run.src_first + run.length * run.src_stride);
+      // If so, along which ROOT 6 axis does the run progress? A run of a
+      // single bin can still pick any axis, longer ones are already set.
+      for (int axis = 0; src_contiguous && (axis < DIMS); ++axis) {
+        if ((run.length > 1) && (axis != run.axis)) continue;
+        bool dest_contiguous = true;
+        for (int dim = 0; dim < DIMS; ++dim) {
+          const Int_t offset = (dim == axis) ? run.length : 0;
+          if (dest_local[dim] != run.dest_first_local[dim] + offset) {
+            dest_contiguous = false;
+            break;
+          }
+        }
+        if (dest_contiguous) {
+          run.axis = axis;
+          run.dest_stride = m_dest_strides[axis];
+          ++run.length;
+          return;
+        }
+      }
+    }
+
+    // Otherwise, start a new run
+    Int_t dest_bin = 0;
+    for (int dim = 0; dim < DIMS; ++dim) {
+      dest_bin += dest_local[dim] * m_dest_strides[dim];
+    }
+    m_runs.push_back(BinRun<DIMS>{src_bin, src_stride,
+                                  dest_bin, m_dest_strides[0],
+                                  dest_local, 0,
+                                  1});
+    m_run_starts.push_back(m_num_bins - 1);
+  }
+
+
+  // === AXIS LAYOUT OF A ROOT 7 HISTOGRAM ===
+
+  // Kinds of ROOT 7 axes that we know how to convert
+  enum class AxisKind { Equidistant, Irregular, Labels };
+
+  // Axis configuration, as far as ROOT 6 histogram construction and bin
+  // indexing are concerned (titles and growability are propagated separately)
+  struct AxisLayout
+  {
+    // Kind of axis
+    AxisKind kind;
+
+    // Number of bins, excluding under- and overflow bins
+    Int_t num_bins;
+
+    // Axis range (equidistant and labeled axes only)
+    Double_t minimum;
+    Double_t maximum;
+
+    // Bin borders (irregular axes only)
+    std::vector<Double_t> bin_borders;
+
+    // Bin labels (labeled axes only)
+    std::vector<std::string> labels;
+
+    // Layouts are ordered so that they can be used as cache keys
+    bool operator<(const AxisLayout& other) const {
+      return std::tie(kind, num_bins, minimum, maximum, bin_borders, labels)
+        < std::tie(other.kind, other.num_bins, other.minimum, other.maximum,
+                   other.bin_borders, other.labels);
+    }
+  };
+
+  // Query the configuration of ROOT 7 axes whose exact type is known
+  AxisLayout describe_equidistant_axis(const RExp::RAxisEquidistant& axis);
+  AxisLayout describe_irregular_axis(const RExp::RAxisIrregular& axis);
+
+  // Query the axis configuration of a ROOT 7 histogram, failing at runtime if
+  // an axis kind is not supported
+  AxisLayout describe_axis(const RExp::RAxisBase& axis);
+  //
+  template <int DIMS>
+  HistLayout<DIMS> describe_axes(const RHistImplPABase<DIMS>& src_impl) {
+    HistLayout<DIMS> layout;
+    for (int axis = 0; axis < DIMS; ++axis) {
+      layout[axis] = describe_axis(src_impl.GetAxis(axis));
+    }
+    return layout;
+  }
+  //
+  // ...or, if the concrete type of the histogram implementation is known, we
+  // can skip the dynamic_casts and go straight to the axes.
+  //
+  template <class DATA, class... AXES>
+  HistLayout<sizeof...(AXES)>
+  describe_axes(const RExp::Detail::RHistImpl<DATA, AXES...>& src_impl) {
+    auto describe_static_axis = [](const auto& axis) -> AxisLayout {
+      using Axis = std::remove_cv_t<std::remove_reference_t<decltype(axis)>>;
+      if constexpr (std::is_same_v<Axis, RExp::RAxisEquidistant>) {
+        return describe_equidistant_axis(axis);
+      } else if constexpr (std::is_same_v<Axis, RExp::RAxisIrregular>) {
+        return describe_irregular_axis(axis);
+      } else {
+        return describe_axis(axis);
+      }
+    };
+    return std::apply(
+      [&](const auto&... axes) {
+        return HistLayout<sizeof...(AXES)>{describe_static_axis(axes)...};
+      },
+      src_impl.GetAxes()
+    );
+  }
+
+  // Truth that an axis still has the layout that was previously recorded for
+  // it, compared in place without copying bin borders or labels.
+  //
+  // The axis kind is not checked, and the axis is expected to be of the
+  // concrete type that goes with the recorded kind (see HistConversionCache,
+  // which knows this from the type of the histogram implementation).
+  //
+  bool axis_matches(const AxisLayout& layout, const RExp::RAxisBase& axis);
+  //
+  template <int DIMS>
+  bool layout_matches(const HistLayout<DIMS>& layout,
+                      const RHistImplPABase<DIMS>& src_impl) {
+    for (int axis = 0; axis < DIMS; ++axis) {
+      if (!axis_matches(layout[axis], src_impl.GetAxis(axis))) return false;
+    }
+    return true;
+  }
+
+  // Compute the centers of the bins of a ROOT 6 axis with a certain layout,
+  // including under- and overflow bins, the way TAxis::GetBinCenter does
+  std::vector<Double_t> root6_bin_centers(const AxisLayout& layout);
+
+  // Check that a ROOT 6 axis has a certain layout, else throw runtime error
+  // NOTE: Cannot use const TAxis& because some TAxis accessors are not const...
+  void check_axis_layout(const AxisLayout& layout, TAxis& axis);
+
+  // Propagate the labels of a labeled axis layout to a ROOT 6 axis, or mark
+  // the ROOT 6 axis as non-alphanumeric if the layout has no labels
+  void setup_axis_labels(TAxis& dest, const AxisLayout& layout);
+
+
+  // === COMPILE-TIME KNOWLEDGE OF ROOT 7 AXIS TYPES ===
+
+  // RHistImpl is templated on the concrete types of its axes, which can give
+  // us the axis kinds of a ROOT 7 histogram at compile time. This lets us
+  // pick the right ROOT 6 constructor statically, and avoid some virtual
+  // calls and dynamic_casts. When the axis kinds are only known at runtime,
+  // we use an empty list of axis kinds.
+  template <AxisKind... KINDS>
+  struct StaticAxisKinds
+  {
+    static constexpr bool is_static = (sizeof...(KINDS) > 0);
+    static constexpr std::array<AxisKind, sizeof...(KINDS)> kinds{KINDS...};
+  };
+  //
+  using DynamicAxisKinds = StaticAxisKinds<>;
+
+  // Candidate concrete types for the RHistImpl behind a RHist
+  //
+  // For each axis, we try RAxisEquidistant and RAxisIrregular, which RHist
+  // uses for equidistant and irregular axis configurations. Labeled and
+  // growable axes are rare enough to be left to the dynamic code path, which
+  // keeps the number of candidates (and instantiations) at 2^DIMS.
+  //
+  // Candidates are numbered by a bit mask, where bit N is set if axis N is
+  // irregular.
+  //
+  template <int CANDIDATE, size_t AXIS>
+  using CandidateAxis = std::conditional_t<((CANDIDATE >> AXIS) & 1) != 0,
+                                           RExp::RAxisIrregular,
+                                           RExp::RAxisEquidistant>;
+  //
+  template <int CANDIDATE, size_t AXIS>
+  constexpr AxisKind CANDIDATE_AXIS_KIND =
+    ((CANDIDATE >> AXIS) & 1) ? AxisKind::Irregular : AxisKind::Equidistant;
+
+  // Find out if the implementation of a ROOT 7 histogram is one of the
+  // candidates above. If so, invoke callback(concrete_impl, StaticAxisKinds)
+  // with it. Otherwise, invoke callback(src_impl, DynamicAxisKinds).
+  template <int CANDIDATE = 0, class DATA, class Callback>
+  decltype(auto) with_static_impl(const RExp::Detail::RHistImplBase<DATA>& impl,
+                                  Callback&& callback);
+  //
+  template <int CANDIDATE, class DATA, class Callback, size_t... AXES>
+  decltype(auto)
+  with_static_impl_candidate(const RExp::Detail::RHistImplBase<DATA>& impl,
+                             Callback&& callback,
+                             std::index_sequence<AXES...>) {
+    using Candidate =
+      RExp::Detail::RHistImpl<DATA, CandidateAxis<CANDIDATE, AXES>...>;
+    if (typeid(impl) == typeid(Candidate)) {
+      return callback(
+        static_cast<const Candidate&>(impl),
+        StaticAxisKinds<CANDIDATE_AXIS_KIND<CANDIDATE, AXES>...>{}
+      );
+    } else {
+      return with_static_impl<CANDIDATE+1>(impl, callback);
+    }
+  }
+  //
+  template <int CANDIDATE, class DATA, class Callback>
+  decltype(auto) with_static_impl(const RExp::Detail::RHistImplBase<DATA>& impl,
+                                  Callback&& callback) {
+    constexpr int DIMS = DATA::GetNDim();
+    if constexpr (CANDIDATE < (1 << DIMS)) {
+      return with_static_impl_candidate<CANDIDATE>(
+        impl,
+        callback,
+        std::make_index_sequence<DIMS>()
+      );
+    } else {
+      return callback(impl, DynamicAxisKinds{});
+    }
+  }
+
+
+  // === MAIN CONVERSION FUNCTIONS ===
+
   // Create a ROOT 6 histogram whose global and per-axis configuration matches
-  // that of an input ROOT 7 histogram as closely as possible.
-  template <class Output, int AXIS, int DIMS, class... BuildParams>
-  Output convert_hist_loop(const RHistImplPABase<DIMS>& src_impl,
+  // an input ROOT 7 histogram axis layout as closely as possible.
+  //
+  // If the axis kinds are known at compile time (Kinds::is_static), only the
+  // matching ROOT 6 histogram constructor is instantiated.
+  //
+  template <class Output, int AXIS, int DIMS, class Kinds, class... BuildParams>
+  Output convert_hist_loop(const HistLayout<DIMS>& layout,
+                           std::tuple<BuildParams...>&& build_params,
+                           bool& must_reconfigure_axes);
+
+  // Iteration of convert_hist_loop for an equidistant axis, possibly labeled
+  template <class Output, int AXIS, int DIMS, class Kinds, class... BuildParams>
+  Output convert_equidistant_axis(const HistLayout<DIMS>& layout,
+                                  std::tuple<BuildParams...>&& build_params,
+                                  bool& must_reconfigure_axes) {
+    // Append equidistant axis constructor parameters to the list of
+    // ROOT 6 histogram constructor parameters
+    const AxisLayout& axis = layout[AXIS];
+    auto new_build_params =
+      std::tuple_cat(
+        std::move(build_params),
+        std::make_tuple(axis.num_bins, axis.minimum, axis.maximum)
+      );
+
+    // Process other axes and construct the histogram
+    auto dest =
+      convert_hist_loop<Output,
+                        AXIS+1,
+                        DIMS,
+                        Kinds>(layout,
+                               std::move(new_build_params),
+                               must_reconfigure_axes);
+
+    // Propagate basic axis properties
+    auto& dest_axis = get_root6_axis(dest, AXIS);
+    if (must_reconfigure_axes) {
+      dest_axis.Set(axis.num_bins, axis.minimum, axis.maximum);
+    }
+
+    // If the axis is labeled, propagate labels
+    setup_axis_labels(dest_axis, axis);
+
+    // Send back the histogram to caller
+    return dest;
+  }
+
+
+  // Iteration of convert_hist_loop for an irregular axis
+  template <class Output, int AXIS, int DIMS, class Kinds, class... BuildParams>
+  Output convert_irregular_axis(const HistLayout<DIMS>& layout,
+                                std::tuple<BuildParams...>&& build_params,
+                                bool& must_reconfigure_axes) {
+    // Append irregular axis constructor parameters to the list of
+    // ROOT 6 histogram constructor parameters
+    const AxisLayout& axis = layout[AXIS];
+    const Double_t* const bin_borders = axis.bin_borders.data();
+    auto new_build_params =
+      std::tuple_cat(
+        std::move(build_params),
+        std::make_tuple(axis.num_bins, bin_borders)
+      );
+
+    // Process other axes and construct the histogram
+    auto dest =
+      convert_hist_loop<Output,
+                        AXIS+1,
+                        DIMS,
+                        Kinds>(layout,
+                               std::move(new_build_params),
+                               must_reconfigure_axes);
+
+    // Propagate basic axis properties
+    auto& dest_axis = get_root6_axis(dest, AXIS);
+    if (must_reconfigure_axes) dest_axis.Set(axis.num_bins, bin_borders);
+
+    // Only RAxisLabels can have labels as of ROOT 6.18
+    setup_axis_labels(dest_axis, axis);
+
+    // Send back the histogram to caller
+    return dest;
+  }
+
+
+  template <class Output, int AXIS, int DIMS, class Kinds, class... BuildParams>
+  Output convert_hist_loop(const HistLayout<DIMS>& layout,
                            std::tuple<BuildParams...>&& build_params,
                            bool& must_reconfigure_axes) {
     // This function is actually a kind of recursive loop for AXIS ranging
     // from 0 to the dimension of the histogram, inclusive.
-    if constexpr (AXIS < DIMS) {
-      // The first iterations query the input histogram axes one by one
-      const auto& axis_view = src_impl.GetAxis(AXIS);
-
-      // Is this an equidistant axis?
-      const auto* eq_axis_ptr =
-        dynamic_cast<const RExp::RAxisEquidistant*>(&axis_view);
-      if (eq_axis_ptr != nullptr) {
-        const auto& eq_axis = *eq_axis_ptr;
-
-        // Append equidistant axis constructor parameters to the list of
-        // ROOT 6 histogram constructor parameters
-        const Int_t num_bins = eq_axis.GetNBinsNoOver();
-        const Double_t minimum = eq_axis.GetMinimum();
-        const Double_t maximum = eq_axis.GetMaximum();
-        auto new_build_params =
-          std::tuple_cat(
-            std::move(build_params),
-            std::make_tuple(num_bins, minimum, maximum)
-          );
-
-        // Process other axes and construct the histogram
-        auto dest =
-          convert_hist_loop<Output,
-                            AXIS+1>(src_impl,
-                                    std::move(new_build_params),
-                                    must_reconfigure_axes);
-
-        // Propagate basic axis properties
-        auto& dest_axis = get_root6_axis(dest, AXIS);
-        if (must_reconfigure_axes) dest_axis.Set(num_bins, minimum, maximum);
-        setup_axis_base(dest_axis, eq_axis);
-
-        // If the axis is labeled, propagate labels
-        const auto* lbl_axis_ptr =
-          dynamic_cast<const RExp::RAxisLabels*>(&eq_axis);
-        if (lbl_axis_ptr) {
-          dest_axis.SetNoAlphanumeric(false);
-          auto labels = lbl_axis_ptr->GetBinLabels();
-          for (size_t bin = 0; bin < labels.size(); ++bin) {
-              std::string label{labels[bin]};
-              dest_axis.SetBinLabel(bin, label.c_str());
-          }
-        } else {
-          dest_axis.SetNoAlphanumeric(true);
-        }
-
-        // Send back the histogram to caller
-        return dest;
+    if constexpr ((AXIS < DIMS) && Kinds::is_static) {
+      // The first iterations go through the input histogram axes one by one.
+      // If the axis kinds are known at compile time, we only need to
+      // instantiate the code for the actual axis kinds.
+      if constexpr (Kinds::kinds[AXIS] == AxisKind::Irregular) {
+        return convert_irregular_axis<Output,
+                                      AXIS,
+                                      DIMS,
+                                      Kinds>(layout,
+                                             std::move(build_params),
+                                             must_reconfigure_axes);
+      } else {
+        return convert_equidistant_axis<Output,
+                                        AXIS,
+                                        DIMS,
+                                        Kinds>(layout,
+                                               std::move(build_params),
+                                               must_reconfigure_axes);
       }
+    } else if constexpr (AXIS < DIMS) {
+      // Otherwise, we must dispatch on the axis kind at runtime
+      switch (layout[AXIS].kind) {
+      case AxisKind::Equidistant:
+      case AxisKind::Labels:
+        return convert_equidistant_axis<Output,
+                                        AXIS,
+                                        DIMS,
+                                        Kinds>(layout,
+                                               std::move(build_params),
+                                               must_reconfigure_axes);
 
-      // Is this an irregular axis?
-      const auto* irr_axis_ptr =
-        dynamic_cast<const RExp::RAxisIrregular*>(&axis_view);
-      if (irr_axis_ptr != nullptr) {
-        const auto& irr_axis = *irr_axis_ptr;
-
-        // Append irregular axis constructor parameters to the list of
-        // ROOT 6 histogram constructor parameters
-        const Int_t num_bins = irr_axis.GetNBinsNoOver();
-        const Double_t* const bin_borders = irr_axis.GetBinBorders().data();
-        auto new_build_params =
-          std::tuple_cat(
-            std::move(build_params),
-            std::make_tuple(num_bins, bin_borders)
-          );
-
-        // Process other axes and construct the histogram
-        auto dest =
-          convert_hist_loop<Output,
-                            AXIS+1>(src_impl,
-                                    std::move(new_build_params),
-                                    must_reconfigure_axes);
-
-        // Propagate basic axis properties
-        auto& dest_axis = get_root6_axis(dest, AXIS);
-        if (must_reconfigure_axes) dest_axis.Set(num_bins, bin_borders);
-        setup_axis_base(dest_axis, irr_axis);
-
-        // Only RAxisLabels can have labels as of ROOT 6.18
-        dest_axis.SetNoAlphanumeric(true);
-
-        // Send back the histogram to caller
-        return dest;
+      case AxisKind::Irregular:
+        return convert_irregular_axis<Output,
+                                      AXIS,
+                                      DIMS,
+                                      Kinds>(layout,
+                                             std::move(build_params),
+                                             must_reconfigure_axes);
       }
 
-      // As of ROOT 6.18.0, there should be no other axis kind, so
+      // describe_axes() should not produce any other axis kind, so
       // reaching this point indicates a bug in the code.
-      throw std::runtime_error("Unsupported histogram axis type");
+      throw std::runtime_error("Unsupported histogram axis kind");
     } else if constexpr (AXIS == DIMS) {
       // We've reached the bottom of the histogram construction recursion.
       // All histogram constructor parameters have been collected in the
@@ -310,123 +867,971 @@ namespace detail
   }
 
 
+  // Find out how the axes and bins of a ROOT 7 histogram map into those of
+  // its ROOT 6 equivalent. This is only computed once per axis layout if the
+  // user provided a plan cache, and repeated conversions of the same
+  // histogram then skip the axis inspection as well.
+  template <class SrcImpl>
+  std::shared_ptr<const ConversionPlan<SrcImpl::GetNDim()>>
+  get_conversion_plan(const SrcImpl& src_impl,
+                      const Root6ConversionOptions& options) {
+    constexpr int DIMS = SrcImpl::GetNDim();
+    const auto& src_stat = src_impl.GetStat();
+    auto describe = [&] { return describe_axes(src_impl); };
+    auto make_plan = [&](const HistLayout<DIMS>& layout) {
+      return std::make_shared<const ConversionPlan<DIMS>>(
+        src_impl,
+        layout,
+        (int)src_stat.sizeNoOver(),
+        (int)src_stat.sizeUnderOver()
+      );
+    };
+    return (options.cache != nullptr)
+             ? options.cache->get_plan(src_impl, describe, make_plan)
+             : make_plan(describe());
+  }
+
+
+  // Global statistics of a ROOT 6 histogram, as used by TH1::GetStats/PutStats
+  //
+  // From the TH1 documentation, stats contains at least...
+  // s[0]  = sumw       s[1]  = sumw2
+  // s[2]  = sumwx      s[3]  = sumwx2
+  // In TH2+, stats also contains...
+  // s[4]  = sumwy      s[5]  = sumwy2   s[6]  = sumwxy
+  // In TH3, stats also contains...
+  // s[7]  = sumwz      s[8]  = sumwz2   s[9]  = sumwxz   s[10]  = sumwyz
+  //
+  using GlobalStats = std::array<Double_t, TH1::kNstat>;
+
+
+  // Add the contribution of one bin to ROOT 6 histogram statistics
+  template <int DIMS>
+  inline void add_bin_stats(GlobalStats& stats,
+                            Double_t w,
+                            Double_t w2,
+                            const std::array<Double_t, DIMS>& coords) {
+    const Double_t x = coords[0];
+    stats[0] += w;
+    stats[1] += w2;
+    stats[2] += w * x;
+    stats[3] += w * x * x;
+    if constexpr (DIMS >= 2) {
+      const Double_t y = coords[1];
+      stats[4] += w * y;
+      stats[5] += w * y * y;
+      stats[6] += w * x * y;
+    }
+    if constexpr (DIMS == 3) {
+      const Double_t y = coords[1];
+      const Double_t z = coords[2];
+      stats[7] += w * z;
+      stats[8] += w * z * z;
+      stats[9] += w * x * z;
+      stats[10] += w * y * z;
+    }
+  }
+
+
+  // Add partial statistics to an accumulator
+  inline void add_stats(GlobalStats& accumulator, const GlobalStats& part) {
+    for (size_t i = 0; i < accumulator.size(); ++i) accumulator[i] += part[i];
+  }
+
+
+  // Granularity at which statistics are accumulated, in bins
+  //
+  // Statistics are accumulated separately for each block of bins, then
+  // summed in block order. This fixed summation order keeps results
+  // bit-for-bit identical no matter how the bins are split across threads,
+  // and whether all blocks or only a few of them are transferred (see
+  // DeltaExporter).
+  //
+  constexpr size_t STATS_BLOCK_BINS = 1024;
+
+  // Granularity at which bin data transfers are split across threads, in bins
+  //
+  // Chunks should be large enough to amortize scheduling overhead, and small
+  // enough to balance the load. Statistics are summed over the blocks of each
+  // chunk, then over chunks.
+  //
+  constexpr size_t TRANSFER_CHUNK_BLOCKS = 64;
+  constexpr size_t TRANSFER_CHUNK_BINS =
+    TRANSFER_CHUNK_BLOCKS * STATS_BLOCK_BINS;
+
+
+  // Range of ROOT 6 local bin indices, along each axis, of the bins which
+  // contribute to global statistics (first and last bin, inclusive)
+  template <int DIMS>
+  using StatsRange = std::array<std::pair<Int_t, Int_t>, DIMS>;
+
+  // Compute the statistics range of a ROOT 6 histogram the way TH1::GetStats
+  // does. Under- and overflow bins are included according to the
+  // histogram's StatOverflows setting, unless the user restricted the axis
+  // range with TAxis::SetRange, in which case only that range is used.
+  //
+  // NOTE: Cannot use const THx& because some TAxis accessors are not const...
+  //
+  template <int DIMS, class Output>
+  StatsRange<DIMS> get_stats_range(Output& dest) {
+    const bool stat_overflows = dest.GetStatOverflowsBehaviour();
+    StatsRange<DIMS> range;
+    for (int axis = 0; axis < DIMS; ++axis) {
+      const TAxis& dest_axis = get_root6_axis(dest, axis);
+      const Int_t num_bins = dest_axis.GetNbins();
+      if (dest_axis.TestBit(TAxis::kAxisRange)) {
+        range[axis] = {dest_axis.GetFirst(), dest_axis.GetLast()};
+      } else if (stat_overflows) {
+        range[axis] = {0, num_bins + 1};
+      } else {
+        range[axis] = {1, num_bins};
+      }
+    }
+    return range;
+  }
+
+
+  // Transfer the bin contents and uncertainties of one block of bins, as
+  // numbered in plan iteration order, and return the partial statistics of
+  // the bins which fall within stats_range.
+  //
+  // Every input bin is only read once: bin contents and uncertainties are
+  // written out and global statistics are accumulated in the same sweep.
+  //
+  // We write into the THx bin array directly instead of going through the
+  // virtual AddBinContent, as the plan covers every bin and the element
+  // types of both histograms match.
+  //
+  // FIXME: If the input RHist computes all of...
+  //        - fTsumw (total sum of weights)
+  //        - fTsumw2 (total sum of square of weights)
+  //        - fTsumwx (total sum of weight*x)
+  //        - fTsumwx2 (total sum of weight*x*x)
+  //
+  //        ...then we should propagate those statistics to the TH1. The
+  //        same applies for the higher-order statistics computed by TH2+.
+  //
+  //        But as of ROOT 6.18.0, we can never do this, because the
+  //        RHistDataMomentUncert stats associated with fTsumwx and
+  //        fTsumwx2 do not expose their contents publicly.
+  //
+  //        Therefore, we must always compute them from bin contents, using
+  //        the same bin centers and uncertainties as TH1::GetStats would.
+  //
+  template <int DIMS, class SrcStat, typename DestElement>
+  GlobalStats transfer_bin_block(const SrcStat& src_stat,
+                                 const ConversionPlan<DIMS>& plan,
+                                 const StatsRange<DIMS>& stats_range,
+                                 size_t block,
+                                 DestElement* dest_content,
+                                 Double_t* dest_sumw2) {
+    const size_t begin = block * STATS_BLOCK_BINS;
+    const size_t end = std::min(begin + STATS_BLOCK_BINS, plan.num_bins());
+    GlobalStats stats{};
+    plan.for_each_run_part(begin, end, [&](const BinRun<DIMS>& run,
+                                           int offset,
+                                           int length) {
+      // Coordinates of the current bin. Only one coordinate changes within
+      // a run, the others are set once at the start of the run.
+      std::array<Double_t, DIMS> coords;
+      for (int dim = 0; dim < DIMS; ++dim) {
+        coords[dim] = plan.bin_centers(dim)[run.dest_first_local[dim]];
+      }
+      const Double_t* const run_centers =
+        plan.bin_centers(run.axis).data() + run.dest_first_local[run.axis];
+
+      // Same for the statistics range: the bins of the run contribute to
+      // statistics if the fixed coordinates are in range, and so is the one
+      // that changes, which we turn into a range of run positions.
+      int stats_begin = offset + length;
+      int stats_end = offset + length;
+      bool run_in_range = true;
+      for (int dim = 0; dim < DIMS; ++dim) {
+        if (dim == run.axis) continue;
+        const Int_t local = run.dest_first_local[dim];
+        run_in_range &= (local >= stats_range[dim].first)
+                        && (local <= stats_range[dim].second);
+      }
+      if (run_in_range) {
+        const Int_t first_local = run.dest_first_local[run.axis];
+        stats_begin = stats_range[run.axis].first - first_local;
+        stats_end = stats_range[run.axis].second - first_local + 1;
+      }
+
+      int src_bin = run.src_first + offset * run.src_stride;
+      Int_t dest_bin = run.dest_first + offset * run.dest_stride;
+      for (int i = offset; i < offset + length; ++i) {
+        const auto content = src_stat.GetBinContent(src_bin);
+        dest_content[dest_bin] = content;
+        const Double_t w = content;
+        Double_t w2;
+        if constexpr (SrcStat::HasBinUncertainty()) {
+          w2 = src_stat.GetSumOfSquaredWeights(src_bin);
+          dest_sumw2[dest_bin] = w2;
+        } else {
+          w2 = std::abs(w);
+        }
+        if ((i >= stats_begin) && (i < stats_end)) {
+          coords[run.axis] = run_centers[i];
+          add_bin_stats<DIMS>(stats, w, w2, coords);
+        }
+
+        src_bin += run.src_stride;
+        dest_bin += run.dest_stride;
+      }
+    });
+    return stats;
+  }
+
+
+  // Number of statistics blocks and transfer chunks covering a plan
+  template <int DIMS>
+  size_t num_stats_blocks(const ConversionPlan<DIMS>& plan) {
+    return (plan.num_bins() + STATS_BLOCK_BINS - 1) / STATS_BLOCK_BINS;
+  }
+  //
+  template <int DIMS>
+  size_t num_transfer_chunks(const ConversionPlan<DIMS>& plan) {
+    return (plan.num_bins() + TRANSFER_CHUNK_BINS - 1) / TRANSFER_CHUNK_BINS;
+  }
+
+
+  // Make sure that a ROOT 6 histogram records bin uncertainties if and only
+  // if the ROOT 7 statistics SrcStat do, and return its array of squared
+  // weights (or nullptr if there is none). "changed" tells whether the ROOT 6
+  // histogram had to be reconfigured, which invalidates its bin data.
+  //
+  // This must be done before inserting any other data in the TH1,
+  // otherwise Sumw2() will perform undesirable black magic...
+  //
+  // FIXME: if constexpr is C++17-only, will need to be backported to C++14
+  //        for ROOT integration.
+  //
+  template <class SrcStat>
+  Double_t* setup_root6_sumw2(TH1& dest, bool& changed) {
+    changed = false;
+    if constexpr (SrcStat::HasBinUncertainty()) {
+      if (dest.GetSumw2N() == 0) {
+        dest.Sumw2();
+        changed = true;
+      }
+      return dest.GetSumw2()->GetArray();
+    } else {
+      if (dest.GetSumw2N() != 0) {
+        dest.Sumw2(false);
+        changed = true;
+      }
+      return nullptr;
+    }
+  }
+
+
+  // Transfer bin contents, uncertainties and statistics from a ROOT 7
+  // histogram into a ROOT 6 histogram with the same axis layout, overwriting
+  // whatever data the ROOT 6 histogram previously contained.
+  template <class Output, class Input>
+  void transfer_hist_data(const Input& src,
+                          const ConversionPlan<Input::GetNDim()>& plan,
+                          Output& dest,
+                          const Root6ConversionOptions& options) {
+    constexpr int DIMS = Input::GetNDim();
+    const auto& src_impl = *src.GetImpl();
+    const auto& src_stat = src_impl.GetStat();
+    using SrcStat = std::remove_reference_t<decltype(src_stat)>;
+
+    // Set up the ROOT 6 histogram's bin uncertainty storage
+    bool sumw2_changed;
+    Double_t* const dest_sumw2 = setup_root6_sumw2<SrcStat>(dest,
+                                                            sumw2_changed);
+
+    // Propagate bin contents and uncertainties chunk by chunk, accumulating
+    // statistics as we go
+    const auto stats_range = get_stats_range<DIMS>(dest);
+    auto* const dest_content = dest.GetArray();
+    const size_t num_blocks = num_stats_blocks(plan);
+    const size_t num_chunks = num_transfer_chunks(plan);
+    auto transfer_chunk = [&](size_t chunk) {
+      const size_t first_block = chunk * TRANSFER_CHUNK_BLOCKS;
+      const size_t last_block =
+        std::min(first_block + TRANSFER_CHUNK_BLOCKS, num_blocks);
+      GlobalStats chunk_stats{};
+      for (size_t block = first_block; block < last_block; ++block) {
+        add_stats(chunk_stats,
+                  transfer_bin_block<DIMS>(src_stat, plan, stats_range, block,
+                                           dest_content, dest_sumw2));
+      }
+      return chunk_stats;
+    };
+    GlobalStats stats{};
+    const size_t num_threads =
+      std::min(size_t(std::max(options.num_threads, 1u)), num_chunks);
+    if (num_threads <= 1) {
+      // Sequential transfer, without any extra allocation
+      for (size_t chunk = 0; chunk < num_chunks; ++chunk) {
+        add_stats(stats, transfer_chunk(chunk));
+      }
+    } else {
+      // Parallel transfer on the shared thread pool, where threads fetch
+      // chunks of work dynamically and partial statistics are reduced in
+      // chunk order afterwards
+      std::vector<GlobalStats> chunk_stats(num_chunks);
+      conversion_thread_pool().parallel_for(
+        num_chunks,
+        num_threads,
+        [&](size_t chunk) { chunk_stats[chunk] = transfer_chunk(chunk); }
+      );
+      for (const auto& part: chunk_stats) {
+        add_stats(stats, part);
+      }
+    }
+
+    // Propagate global histogram statistics
+    dest.SetEntries(src.GetEntries());
+    dest.PutStats(stats.data());
+  }
+
+
+  // Common implementation of convert_hist and convert_hist_detached
+  template <class Output, bool DETACHED, class Input>
+  auto convert_hist_impl(const Input& src,
+                         const char* name,
+                         const Root6ConversionOptions& options) {
+    constexpr int DIMS = Input::GetNDim();
+    using Result = std::conditional_t<DETACHED,
+                                      std::unique_ptr<Output>,
+                                      Output>;
+
+    // Make sure that the input histogram's impl-pointer is set
+    const auto* impl_ptr = src.GetImpl();
+    if (impl_ptr == nullptr) {
+      throw std::runtime_error("Input histogram has a null impl pointer");
+    }
+
+    // Use the concrete type of the histogram implementation if we know it
+    return with_static_impl(*impl_ptr, [&](const auto& impl,
+                                           auto kinds) -> Result {
+      using Kinds = decltype(kinds);
+
+      // Compute the first ROOT 6 histogram constructor parameters
+      //
+      // Beware that "title" must remain a separate variable, otherwise
+      // the title string will be deallocated before use...
+      //
+      auto title = convert_hist_title(impl.GetTitle());
+      auto first_build_params = std::make_tuple(name, title.c_str());
+
+      // Find out the axis configuration and bin mapping, which may come from
+      // the plan cache
+      const auto plan = get_conversion_plan(impl, options);
+      const HistLayout<DIMS>& layout = plan->layout();
+
+      // Build the ROOT 6 histogram, copying src's axis configuration
+      //
+      // THx construction registers the histogram into ROOT 6 global state,
+      // so it is serialized in case several histograms are converted in
+      // parallel.
+      //
+      std::unique_lock<std::mutex> global_state_lock{
+        root6_global_state_mutex()
+      };
+      bool must_reconfigure_axes;
+      auto build = [&] {
+        return convert_hist_loop<Output, 0, DIMS, Kinds>(
+          layout,
+          std::move(first_build_params),
+          must_reconfigure_axes
+        );
+      };
+      //
+      // Detached histograms are built on the heap, where "new auto"
+      // constructs the histogram returned by "build" in place. They are
+      // thus never copied or destroyed while the lock is not held, which
+      // would add them to or remove them from a ROOT directory.
+      //
+      auto result = [&]() -> Result {
+        if constexpr (DETACHED) {
+          return std::unique_ptr<Output>{ new auto(build()) };
+        } else {
+          return build();
+        }
+      }();
+      Output* dest_ptr;
+      if constexpr (DETACHED) {
+        dest_ptr = result.get();
+        dest_ptr->SetDirectory(nullptr);
+      } else {
+        dest_ptr = &result;
+      }
+      Output& dest = *dest_ptr;
+
+      // Propagate basic axis properties
+      for (int axis = 0; axis < DIMS; ++axis) {
+        setup_axis_base(get_root6_axis(dest, axis), impl.GetAxis(axis));
+      }
+
+      // Make sure that under- and overflow bins are included in the
+      // statistics, to match the ROOT 7 behavior (as of ROOT v6.18.0).
+      dest.SetStatOverflows(TH1::EStatOverflows::kConsider);
+
+      // Use normal statistics for bin errors, since ROOT7 doesn't seem to
+      // support Poisson bin error computation yet.
+      dest.SetBinErrorOption(TH1::EBinErrorOpt::kNormal);
+
+      // Set norm factor to zero (disable), since ROOT 7 doesn't seem to have
+      // this
+      dest.SetNormFactor(0);
+      global_state_lock.unlock();
+
+      // Now we're ready to transfer histogram data, which can proceed in
+      // parallel with other conversions
+      transfer_hist_data(src, *plan, dest, options);
+
+      // Return the ROOT 6 histogram to the caller
+      return result;
+    });
+  }
+
+
   // Convert a ROOT 7 histogram into a ROOT 6 one
   template <class Output, class Input>
-  Output convert_hist(const Input& src, const char* name) {
+  Output convert_hist(const Input& src,
+                      const char* name,
+                      const Root6ConversionOptions& options) {
+    return convert_hist_impl<Output, false>(src, name, options);
+  }
+
+
+  // Convert a ROOT 7 histogram into a heap-allocated ROOT 6 one, which is not
+  // attached to any ROOT directory
+  template <class Output, class Input>
+  std::unique_ptr<Output> convert_hist_detached(
+    const Input& src,
+    const char* name,
+    const Root6ConversionOptions& options
+  ) {
+    return convert_hist_impl<Output, true>(src, name, options);
+  }
+
+
+  // Refresh a ROOT 6 histogram that was previously produced by convert_hist
+  // (or has the same axis configuration) with the current contents of a
+  // ROOT 7 histogram.
+  template <class Output, class Input>
+  void refresh_hist(const Input& src,
+                    Output& dest,
+                    const Root6ConversionOptions& options) {
+    constexpr int DIMS = Input::GetNDim();
+
     // Make sure that the input histogram's impl-pointer is set
     const auto* impl_ptr = src.GetImpl();
     if (impl_ptr == nullptr) {
       throw std::runtime_error("Input histogram has a null impl pointer");
     }
-    const auto& impl = *impl_ptr;
 
-    // Compute the first ROOT 6 histogram constructor parameters
+    // Use the concrete type of the histogram implementation if we know it
+    with_static_impl(*impl_ptr, [&](const auto& impl, auto /* kinds */) {
+      // Check that the output histogram's bins are laid out like the
+      // input's, so that the rest of the refresh is a pure data transfer
+      const auto plan = get_conversion_plan(impl, options);
+      for (int axis = 0; axis < DIMS; ++axis) {
+        check_axis_layout(plan->layout()[axis], get_root6_axis(dest, axis));
+      }
+
+      // Overwrite the output histogram's data
+      transfer_hist_data(src, *plan, dest, options);
+    });
+  }
+
+
+  // Convert a ROOT 6 histogram into a ROOT 7 one
+  template <class Output, class Input>
+  Output convert_hist_to_root7(const Input& src) {
+    constexpr int DIMS = Output::GetNDim();
+
+    // Build the ROOT 7 histogram, copying src's axis configuration.
     //
-    // Beware that "title" must remain a separate variable, otherwise
-    // the title string will be deallocated before use...
+    // There is no need to escape the title, as ROOT 6 already turned the
+    // "#;" sequences back into semicolons.
     //
-    auto title = convert_hist_title(impl.GetTitle());
-    auto first_build_params = std::make_tuple(name, title.c_str());
+    Output dest(src.GetTitle(),
+                get_root7_axis_configs(src, std::make_index_sequence<DIMS>()));
+    auto& dest_impl = *dest.GetImpl();
+    auto& dest_stat = dest_impl.GetStat();
 
-    // Build the ROOT 6 histogram, copying src's axis configuration
-    bool must_reconfigure_axes;
-    auto dest = convert_hist_loop<Output, 0>(impl,
-                                             std::move(first_build_params),
-                                             must_reconfigure_axes);
+    // Propagate the entry count. ROOT 7 counts entries with an integer, so
+    // ROOT 6 histograms with a fractional or negative entry count (e.g.
+    // after Scale() or Add() with a negative factor) cannot be converted.
+    const Double_t entries = src.GetEntries();
+    if ((entries < 0) || (entries != std::floor(entries))) {
+      throw std::runtime_error("ROOT 7 histograms require an integral, "
+                               "non-negative entry count");
+    }
+    add_entries(dest_stat, static_cast<int64_t>(entries));
 
-    // Make sure that under- and overflow bins are included in the
-    // statistics, to match the ROOT 7 behavior (as of ROOT v6.18.0).
-    dest.SetStatOverflows(TH1::EStatOverflows::kConsider);
+    // Bulk-copy bin contents and uncertainties into the ROOT 7 statistics,
+    // going through the same bin mapping as ROOT 7 -> ROOT 6 conversions.
+    //
+    // Without Sumw2, ROOT 6 treats the bin contents as the sum of squared
+    // weights, so we do the same.
+    //
+    const HistLayout<DIMS> layout = describe_axes(dest_impl);
+    const ConversionPlan<DIMS> plan(dest_impl,
+                                    layout,
+                                    (int)dest_stat.sizeNoOver(),
+                                    (int)dest_stat.sizeUnderOver());
+    const auto* const src_content = src.GetArray();
+    const Double_t* const src_sumw2 =
+      (src.GetSumw2N() != 0) ? src.GetSumw2()->GetArray() : nullptr;
+    plan.for_each_bin([&](int dest_bin, Int_t src_bin) {
+      const auto content = src_content[src_bin];
+      dest_stat.GetBinContent(dest_bin) = content;
+      dest_stat.GetSumOfSquaredWeights(dest_bin) =
+        (src_sumw2 != nullptr) ? src_sumw2[src_bin]
+                               : std::abs(Double_t(content));
+    });
 
-    // Use normal statistics for bin errors, since ROOT7 doesn't seem to support
-    // Poisson bin error computation yet.
-    dest.SetBinErrorOption(TH1::EBinErrorOpt::kNormal);
+    // Return the ROOT 7 histogram to the caller
+    return dest;
+  }
 
-    // Set norm factor to zero (disable), since ROOT 7 doesn't seem to have this
-    dest.SetNormFactor(0);
 
-    // Now we're ready to transfer histogram data.
-    // This is how we turn a ROOT 7 global bin index into its ROOT 6 equivalent.
-    const auto& src_impl = *src.GetImpl();
-    auto to_dest_bin = [&](const int src_bin) -> Int_t {
-      // Convert to per-axis local bin coordinates
-      auto local_bins = src_impl.GetLocalBins(src_bin);
+  // === THn AND THnSparse OUTPUT ===
 
-      // Move to the ROOT 6 under/overflow bin indexing convention
-      for (int dim = 0; dim < src.GetNDim(); ++dim) {
-        if (local_bins[dim] == -1) {
-          local_bins[dim] = 0;
-        } else if (local_bins[dim] == -2) {
-          local_bins[dim] = src_impl.GetAxis(dim).GetNBins() - 1;
-        }
-      }
+  // Build an empty THn or THnSparse whose axis configuration matches that of
+  // a ROOT 7 histogram
+  //
+  // Unlike THx, these have a single constructor for all axis kinds, which
+  // takes per-axis arrays. Irregular bin borders are set after the fact.
+  // They cannot be copied or moved, so they are allocated on the heap.
+  //
+  template <class Output, int DIMS>
+  std::unique_ptr<Output>
+  make_root6_ndim_hist(const RHistImplPABase<DIMS>& impl,
+                       const HistLayout<DIMS>& layout,
+                       const char* name) {
+    std::array<Int_t, DIMS> num_bins;
+    std::array<Double_t, DIMS> minima, maxima;
+    for (int axis = 0; axis < DIMS; ++axis) {
+      num_bins[axis] = layout[axis].num_bins;
+      minima[axis] = layout[axis].minimum;
+      maxima[axis] = layout[axis].maximum;
+    }
 
-      // Turn our local ROOT 6 coordinates into global ones
-      return get_bin_idx_from_local_root6(dest, local_bins);
+    // Construction touches ROOT 6 global state, as for THx
+    const auto title = convert_hist_title(impl.GetTitle());
+    std::lock_guard<std::mutex> global_state_lock{
+      root6_global_state_mutex()
     };
+    auto dest = std::make_unique<Output>(name,
+                                         title.c_str(),
+                                         DIMS,
+                                         num_bins.data(),
+                                         minima.data(),
+                                         maxima.data());
+    for (int axis = 0; axis < DIMS; ++axis) {
+      if (layout[axis].kind == AxisKind::Irregular) {
+        dest->SetBinEdges(axis, layout[axis].bin_borders.data());
+      }
+      auto& dest_axis = *dest->GetAxis(axis);
+      setup_axis_base(dest_axis, impl.GetAxis(axis));
+      setup_axis_labels(dest_axis, layout[axis]);
+    }
+    return dest;
+  }
 
-    // This is how we iterate over bins of the input ROOT 7 histogram, invoking
-    // a callback with the index of the input bin and that of the matching bin
-    // in the output ROOT 6 histogram.
-    const auto& src_stat = src_impl.GetStat();
-    auto for_each_src_bin = [&](auto&& bin_indices_callback) {
-      for (int src_bin = 1; src_bin <= (int)src_stat.sizeNoOver(); ++src_bin) {
-        bin_indices_callback(src_bin, to_dest_bin(src_bin));
+
+  // Convert a ROOT 7 histogram into a THn or THnSparse
+  //
+  // THnBase has no equivalent of TH1::PutStats, so only bin data and the
+  // entry count are propagated. Bins are transferred one by one through the
+  // THnBase interface, as THn does not expose its bin arrays.
+  //
+  template <class Output, class Input>
+  std::unique_ptr<Output> convert_hist_to_thn(const Input& src,
+                                              const char* name) {
+    constexpr int DIMS = Input::GetNDim();
+    constexpr bool is_sparse = std::is_base_of_v<THnSparse, Output>;
+
+    // Make sure that the input histogram's impl-pointer is set
+    const auto* impl_ptr = src.GetImpl();
+    if (impl_ptr == nullptr) {
+      throw std::runtime_error("Input histogram has a null impl pointer");
+    }
+    const auto& impl = *impl_ptr;
+
+    // Build the ROOT 6 histogram, copying src's axis configuration
+    const HistLayout<DIMS> layout = describe_axes(impl);
+    auto dest_ptr = make_root6_ndim_hist<Output, DIMS>(impl, layout, name);
+    Output& dest = *dest_ptr;
+    std::array<Int_t, DIMS> dest_overflow_local;
+    for (int axis = 0; axis < DIMS; ++axis) {
+      dest_overflow_local[axis] = layout[axis].num_bins + 1;
+    }
+
+    // Only record bin errors if the input histogram has them. Otherwise,
+    // THnBase treats bin contents as the sum of squared weights, as we do.
+    const auto& src_stat = impl.GetStat();
+    using SrcStat = std::remove_reference_t<decltype(src_stat)>;
+    if constexpr (SrcStat::HasBinUncertainty()) dest.Sumw2();
+
+    // Transfer a bin, skipping it if it is empty and the output is sparse
+    std::array<Int_t, DIMS> dest_local;
+    auto transfer_bin = [&](const int src_bin) {
+      const Double_t content = src_stat.GetBinContent(src_bin);
+      Double_t sumw2 = 0.;
+      if constexpr (SrcStat::HasBinUncertainty()) {
+        sumw2 = src_stat.GetSumOfSquaredWeights(src_bin);
+      }
+      if (is_sparse && (content == 0.) && (sumw2 == 0.)) return;
+
+      // Map the bin into ROOT 6's under/overflow bin indexing convention.
+      // For sparse outputs, this is where the bin gets allocated.
+      const auto src_local = impl.GetLocalBins(src_bin);
+      for (int axis = 0; axis < DIMS; ++axis) {
+        if (src_local[axis] == -1) {
+          dest_local[axis] = 0;
+        } else if (src_local[axis] == -2) {
+          dest_local[axis] = dest_overflow_local[axis];
+        } else {
+          dest_local[axis] = src_local[axis];
+        }
       }
-      for (int src_bin = -1; src_bin >= -(int)src_stat.sizeUnderOver(); --src_bin) {
-        bin_indices_callback(src_bin, to_dest_bin(src_bin));
+      const Long64_t dest_bin = dest.GetBin(dest_local.data());
+
+      // Write down the bin data
+      dest.SetBinContent(dest_bin, content);
+      if constexpr (SrcStat::HasBinUncertainty()) {
+        dest.SetBinError2(dest_bin, sumw2);
       }
     };
 
-    // Propagate bin uncertainties, if present.
-    //
-    // This must be done before inserting any other data in the TH1,
-    // otherwise Sumw2() will perform undesirable black magic...
-    //
-    // FIXME: if constexpr is C++17-only, will need to be backported to C++14
-    //        for ROOT integration.
-    //
-    if constexpr (src_stat.HasBinUncertainty()) {
-      dest.Sumw2();
-      auto& sumw2 = *dest.GetSumw2();
-      for_each_src_bin([&](int src_bin, Int_t dest_bin) {
-        sumw2[dest_bin] = src_stat.GetSumOfSquaredWeights(src_bin);
-      });
+    // Go through every input bin, in ROOT 7 bin iteration order
+    const int num_regular_bins = src_stat.sizeNoOver();
+    const int num_overflow_bins = src_stat.sizeUnderOver();
+    for (int src_bin = 1; src_bin <= num_regular_bins; ++src_bin) {
+      transfer_bin(src_bin);
+    }
+    for (int src_bin = -1; src_bin >= -num_overflow_bins; --src_bin) {
+      transfer_bin(src_bin);
     }
 
-    // Propagate basic histogram statistics
+    // Propagate the entry count and return the histogram to the caller
     dest.SetEntries(src.GetEntries());
-    for_each_src_bin([&](int src_bin, Int_t dest_bin) {
-      dest.AddBinContent(dest_bin, src_stat.GetBinContent(src_bin));
-    });
+    return dest_ptr;
+  }
+}
 
-    // Compute remaining statistics
-    //
-    // FIXME: If the input RHist computes all of...
-    //        - fTsumw (total sum of weights)
-    //        - fTsumw2 (total sum of square of weights)
-    //        - fTsumwx (total sum of weight*x)
-    //        - fTsumwx2 (total sum of weight*x*x)
-    //
-    //        ...then we should propagate those statistics to the TH1. The
-    //        same applies for the higher-order statistics computed by TH2+.
-    //
-    //        But as of ROOT 6.18.0, we can never do this, because the
-    //        RHistDataMomentUncert stats associated with fTsumwx and
-    //        fTsumwx2 do not expose their contents publicly.
-    //
-    //        Therefore, we must always ask TH1 to do the computation
-    //        for us. It's better to do so using a GetStats/PutStats
-    //        pair, as ResetStats alters more than those stats...
-    //
-    //        The same problem occurs with the higher-order statistics
-    //        computed by TH2+, but this approach is dimension-agnostic.
-    //
-    std::array<Double_t, TH1::kNstat> stats;
-    dest.GetStats(stats.data());
-    dest.PutStats(stats.data());
 
-    // Return the ROOT 6 histogram to the caller
-    return dest;
+// === CONVERSION PLAN CACHE ===
+
+// Internal state of HistConversionCache
+struct HistConversionCache::Impl
+{
+  // Cached conversion plans of each dimensionality, keyed by axis layout
+  template <int DIMS>
+  using PlanMap =
+    std::map<detail::HistLayout<DIMS>,
+             std::shared_ptr<const detail::ConversionPlan<DIMS>>>;
+  std::tuple<PlanMap<1>, PlanMap<2>, PlanMap<3>> plans;
+
+  // Plans of the histograms that were converted before, keyed by the type
+  // and address of their implementation. The type tells the axis kinds, so
+  // only the axis parameters need to be checked on a hit, in case the
+  // histogram has grown or another one took its place in memory.
+  using SourceKey = std::pair<std::type_index, const void*>;
+  template <int DIMS>
+  using SourceMap =
+    std::map<SourceKey, std::shared_ptr<const detail::ConversionPlan<DIMS>>>;
+  std::tuple<SourceMap<1>, SourceMap<2>, SourceMap<3>> sources;
+
+  // Protects "plans" and "sources" against concurrent access
+  std::mutex mutex;
+
+  // Cache hit and miss counters
+  std::atomic<size_t> hits = 0;
+  std::atomic<size_t> misses = 0;
+};
+
+
+template <class SrcImpl, typename DescribeAxes, typename MakePlan>
+std::shared_ptr<const detail::ConversionPlan<SrcImpl::GetNDim()>>
+HistConversionCache::get_plan(const SrcImpl& src_impl,
+                              DescribeAxes&& describe_axes,
+                              MakePlan&& make_plan)
+{
+  constexpr int DIMS = SrcImpl::GetNDim();
+  auto& plans = std::get<DIMS-1>(m_impl->plans);
+  auto& sources = std::get<DIMS-1>(m_impl->sources);
+  const Impl::SourceKey source_key{typeid(src_impl),
+                                   dynamic_cast<const void*>(&src_impl)};
+
+  // Did we convert this very histogram before?
+  {
+    std::lock_guard<std::mutex> lock{m_impl->mutex};
+    const auto it = sources.find(source_key);
+    if ((it != sources.end())
+        && detail::layout_matches<DIMS>(it->second->layout(), src_impl)) {
+      m_impl->hits.fetch_add(1, std::memory_order_relaxed);
+      return it->second;
+    }
+  }
+
+  // If not, is there a plan for this axis layout already?
+  const detail::HistLayout<DIMS> layout = describe_axes();
+  {
+    std::lock_guard<std::mutex> lock{m_impl->mutex};
+    const auto it = plans.find(layout);
+    if (it != plans.end()) {
+      m_impl->hits.fetch_add(1, std::memory_order_relaxed);
+      sources[source_key] = it->second;
+      return it->second;
+    }
+  }
+
+  // If not, compute one without holding the lock, and record it. Another
+  // thread may have raced with us, in which case we use its plan.
+  m_impl->misses.fetch_add(1, std::memory_order_relaxed);
+  auto plan = make_plan(layout);
+  std::lock_guard<std::mutex> lock{m_impl->mutex};
+  const auto& result = plans.emplace(layout, std::move(plan)).first->second;
+  sources[source_key] = result;
+  return result;
+}
+
+
+// === DELTA EXPORT ===
+
+// Fill wrapper around a ROOT 7 histogram, which keeps track of the bins that
+// were modified since the last export to ROOT 6, so that periodic exports
+// only need to transfer those bins into the previously exported histogram.
+//
+// The bins are tracked in blocks of detail::STATS_BLOCK_BINS. The partial
+// statistics of each block are kept from one export to the next, so an
+// export costs a fixed amount of work per modified block, plus a small amount
+// of work per detail::TRANSFER_CHUNK_BINS bins for the global statistics.
+// Exported histograms are bit-for-bit identical to full conversions.
+//
+// All fills must go through this wrapper, otherwise the affected bins may not
+// be exported. Growable axes are not supported, as growing an axis would
+// change the layout of the whole histogram.
+//
+template <typename Root7Hist>
+class DeltaExporter
+{
+public:
+  static constexpr int DIMS = Root7Hist::GetNDim();
+  using CoordArray_t = typename Root7Hist::CoordArray_t;
+  using Weight_t = typename Root7Hist::Weight_t;
+  using Output =
+    decltype(into_root6_hist(std::declval<const Root7Hist&>(), ""));
+
+  // Start tracking a ROOT 7 histogram, which must outlive the exporter.
+  // Initially, every bin is considered modified.
+  explicit DeltaExporter(Root7Hist& hist,
+                         const Root6ConversionOptions& options = {});
+
+  // Fill the ROOT 7 histogram, recording which bins were modified
+  void Fill(const CoordArray_t& x, Weight_t weight = 1.);
+  void FillN(const std::span<const CoordArray_t> xN,
+             const std::span<const Weight_t> weightN);
+  void FillN(const std::span<const CoordArray_t> xN);
+
+  // Number of blocks of bins that the next export will transfer
+  size_t num_dirty_blocks() const { return m_dirty_blocks.size(); }
+
+  // Update a ROOT 6 histogram with the bins that were modified since the
+  // last export, along with global statistics.
+  //
+  // "dest" must be the histogram that the previous export went to. For the
+  // first export, it can be any histogram with the same axis configuration,
+  // e.g. one produced by into_root6_hist. A runtime error is thrown if its
+  // axis configuration does not match that of the ROOT 7 histogram.
+  //
+  void export_to(Output& dest);
+
+private:
+  // Mark the block containing some ROOT 7 global bin as modified
+  void mark_dirty(int bin);
+
+  // Mark all blocks as modified
+  void mark_all_dirty();
+
+  // Tracked histogram and its ROOT 7 -> ROOT 6 axis and bin mapping
+  Root7Hist& m_hist;
+  std::shared_ptr<const detail::ConversionPlan<DIMS>> m_plan;
+
+  // Number of regular ROOT 7 bins, used to locate bins in the plan
+  int m_num_regular_bins;
+
+  // Modified blocks, as a bitmap for deduplication and as a list so that
+  // exports do not need to scan the whole bitmap
+  std::vector<bool> m_is_dirty;
+  std::vector<size_t> m_dirty_blocks;
+
+  // Same for the transfer chunks whose statistics must be recomputed
+  std::vector<bool> m_is_chunk_dirty;
+  std::vector<size_t> m_dirty_chunks;
+
+  // Partial statistics of each block and of each transfer chunk, and range
+  // of bins that they cover, as of the last export
+  detail::StatsRange<DIMS> m_stats_range{};
+  std::vector<detail::GlobalStats> m_block_stats;
+  std::vector<detail::GlobalStats> m_chunk_stats;
+};
+
+
+template <typename Root7Hist>
+DeltaExporter<Root7Hist>::DeltaExporter(Root7Hist& hist,
+                                        const Root6ConversionOptions& options)
+  : m_hist(hist)
+{
+  // Make sure that the input histogram's impl-pointer is set
+  const auto* impl_ptr = hist.GetImpl();
+  if (impl_ptr == nullptr) {
+    throw std::runtime_error("Input histogram has a null impl pointer");
+  }
+  const auto& impl = *impl_ptr;
+
+  // Growable axes would invalidate the axis layout
+  for (int axis = 0; axis < DIMS; ++axis) {
+    if (impl.GetAxis(axis).CanGrow()) {
+      throw std::runtime_error("Delta export does not support growable axes");
+    }
+  }
+
+  // Compute the bin mapping once and for all
+  detail::with_static_impl(impl, [&](const auto& typed_impl, auto /* kinds */) {
+    m_plan = detail::get_conversion_plan(typed_impl, options);
+  });
+  m_num_regular_bins = impl.GetStat().sizeNoOver();
+
+  // Set up bin tracking, with all bins initially considered modified
+  const size_t num_blocks = detail::num_stats_blocks(*m_plan);
+  m_is_dirty.resize(num_blocks);
+  m_dirty_blocks.reserve(num_blocks);
+  m_block_stats.resize(num_blocks);
+  const size_t num_chunks = detail::num_transfer_chunks(*m_plan);
+  m_is_chunk_dirty.resize(num_chunks);
+  m_dirty_chunks.reserve(num_chunks);
+  m_chunk_stats.resize(num_chunks);
+  mark_all_dirty();
+}
+
+
+template <typename Root7Hist>
+void DeltaExporter<Root7Hist>::Fill(const CoordArray_t& x, Weight_t weight) {
+  // This is what RHistImpl::Fill does for non-growable axes, except that we
+  // also get to know which bin was filled
+  auto& impl = *m_hist.GetImpl();
+  const int bin = impl.GetBinIndex(x);
+  mark_dirty(bin);
+  impl.GetStat().Fill(x, bin, weight);
+}
+
+
+template <typename Root7Hist>
+void DeltaExporter<Root7Hist>::FillN(const std::span<const CoordArray_t> xN,
+                                     const std::span<const Weight_t> weightN)
+{
+  if (xN.size() != weightN.size()) {
+    throw std::runtime_error("Not the same number of points and weights");
+  }
+  for (size_t i = 0; i < xN.size(); ++i) {
+    Fill(xN[i], weightN[i]);
+  }
+}
+
+
+template <typename Root7Hist>
+void DeltaExporter<Root7Hist>::FillN(const std::span<const CoordArray_t> xN) {
+  for (const auto& x: xN) {
+    Fill(x);
+  }
+}
+
+
+template <typename Root7Hist>
+void DeltaExporter<Root7Hist>::export_to(Output& dest) {
+  // Check that the output histogram's bins are laid out like the input's
+  for (int axis = 0; axis < DIMS; ++axis) {
+    detail::check_axis_layout(m_plan->layout()[axis],
+                              detail::get_root6_axis(dest, axis));
+  }
+
+  // Set up bin uncertainty storage. If it had to change, all bin data must
+  // be transferred again.
+  const auto& src_stat = m_hist.GetImpl()->GetStat();
+  using SrcStat = std::remove_reference_t<decltype(src_stat)>;
+  bool sumw2_changed;
+  Double_t* const dest_sumw2 =
+    detail::setup_root6_sumw2<SrcStat>(dest, sumw2_changed);
+  if (sumw2_changed) mark_all_dirty();
+
+  // Same if the range of bins covered by statistics has changed
+  const auto stats_range = detail::get_stats_range<DIMS>(dest);
+  if (stats_range != m_stats_range) {
+    m_stats_range = stats_range;
+    mark_all_dirty();
+  }
+
+  // Transfer modified blocks, and record which transfer chunks they belong to
+  auto* const dest_content = dest.GetArray();
+  for (const size_t block: m_dirty_blocks) {
+    m_block_stats[block] =
+      detail::transfer_bin_block<DIMS>(src_stat, *m_plan, m_stats_range,
+                                       block, dest_content, dest_sumw2);
+    m_is_dirty[block] = false;
+    const size_t chunk = block / detail::TRANSFER_CHUNK_BLOCKS;
+    if (!m_is_chunk_dirty[chunk]) {
+      m_is_chunk_dirty[chunk] = true;
+      m_dirty_chunks.push_back(chunk);
+    }
+  }
+
+  // Recompute the statistics of these chunks
+  for (const size_t chunk: m_dirty_chunks) {
+    const size_t first_block = chunk * detail::TRANSFER_CHUNK_BLOCKS;
+    const size_t last_block = std::min(first_block
+                                         + detail::TRANSFER_CHUNK_BLOCKS,
+                                       m_block_stats.size());
+    m_chunk_stats[chunk] = detail::GlobalStats{};
+    for (size_t block = first_block; block < last_block; ++block) {
+      detail::add_stats(m_chunk_stats[chunk], m_block_stats[block]);
+    }
+    m_is_chunk_dirty[chunk] = false;
+  }
+  m_dirty_chunks.clear();
+  m_dirty_blocks.clear();
+
+  // Propagate global histogram statistics, summed in the same order as
+  // a full conversion would
+  detail::GlobalStats stats{};
+  for (const auto& chunk_stats: m_chunk_stats) {
+    detail::add_stats(stats, chunk_stats);
+  }
+  dest.SetEntries(m_hist.GetEntries());
+  dest.PutStats(stats.data());
+}
+
+
+template <typename Root7Hist>
+void DeltaExporter<Root7Hist>::mark_dirty(int bin) {
+  // The plan goes through regular bins first, then under- and overflow bins
+  const size_t position = (bin > 0) ? (bin - 1)
+                                    : (m_num_regular_bins - bin - 1);
+  const size_t block = position / detail::STATS_BLOCK_BINS;
+  if (!m_is_dirty[block]) {
+    m_is_dirty[block] = true;
+    m_dirty_blocks.push_back(block);
+  }
+}
+
+
+template <typename Root7Hist>
+void DeltaExporter<Root7Hist>::mark_all_dirty() {
+  m_dirty_blocks.clear();
+  for (size_t block = 0; block < m_is_dirty.size(); ++block) {
+    m_is_dirty[block] = true;
+    m_dirty_blocks.push_back(block);
   }
-}
\ No newline at end of file
+}
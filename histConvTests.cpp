@@ -10,8 +10,108 @@ int main() {
   assert_runtime_error([]() { into_root6_hist(RExp::RHist<1, char>(), "bad"); },
                        "Converting a null histogram should fail");
 
+  // Refreshing a ROOT 6 histogram with a different axis configuration should
+  // fail with a clear exception as well
+  assert_runtime_error([]() {
+    RExp::RHist<1, char> src(RExp::RAxisConfig(10, 0., 1.));
+    RExp::RHist<1, char> other(RExp::RAxisConfig(20, 0., 1.));
+    auto dest = into_root6_hist(other, "bad_refresh");
+    into_root6_hist(src, dest);
+  }, "Refreshing a histogram with a different axis layout should fail");
+
+  // ...and so should refreshing a labeled histogram with different labels
+  assert_runtime_error([]() {
+    RExp::RHist<1, char> src(RExp::RAxisConfig({"a", "b", "c"}));
+    RExp::RHist<1, char> other(RExp::RAxisConfig({"a", "b", "d"}));
+    auto dest = into_root6_hist(other, "bad_label_refresh");
+    into_root6_hist(src, dest);
+  }, "Refreshing a histogram with different bin labels should fail");
+
   // For the most part, we'll use reproducible but pseudo-random test data...
   RNG rng;
+
+  // Multi-threaded conversion of histograms large enough to be split across
+  // threads should produce exactly the same result as sequential conversion
+  {
+    RExp::RHist<3, double> src({RExp::RAxisConfig(100, -1., 1.),
+                                RExp::RAxisConfig(50, -2., 2.),
+                                RExp::RAxisConfig(40, -3., 3.)});
+    for (size_t i = 0; i < 100000; ++i) {
+      src.Fill({gen_double(rng, -1.1, 1.1),
+                gen_double(rng, -2.2, 2.2),
+                gen_double(rng, -3.3, 3.3)},
+               gen_double(rng, WEIGHT_RANGE.first, WEIGHT_RANGE.second));
+    }
+    const auto seq = into_root6_hist(src, gen_unique_hist_name().c_str());
+    Root6ConversionOptions options;
+    options.num_threads = 4;
+    const auto par =
+      into_root6_hist(src, gen_unique_hist_name().c_str(), options);
+    for (Int_t bin = 0; bin < seq.GetNcells(); ++bin) {
+      ASSERT_EQ(par.GetBinContent(bin), seq.GetBinContent(bin),
+                "Parallel conversion should produce the same bin contents");
+      ASSERT_EQ(par.GetBinError(bin), seq.GetBinError(bin),
+                "Parallel conversion should produce the same bin errors");
+    }
+    std::array<Double_t, TH1::kNstat> seq_stats, par_stats;
+    seq.GetStats(seq_stats.data());
+    par.GetStats(par_stats.data());
+    ASSERT_EQ(par_stats, seq_stats,
+              "Parallel conversion should produce the same statistics");
+  }
+
+  // Batch conversion should convert heterogeneous histograms in order, and
+  // report failures without affecting the other conversions
+  {
+    RExp::RHist<1, char> hist1d(RExp::RAxisConfig(10, 0., 1.));
+    RExp::RHist<1, char> null_hist;
+    RExp::RHist<2, float> hist2d({RExp::RAxisConfig(5, 0., 1.),
+                                  RExp::RAxisConfig(7, -1., 1.)});
+    hist1d.Fill({0.5});
+    hist2d.Fill({0.5, 0.5}, 2.f);
+    std::vector<Root6ConversionJob> jobs;
+    jobs.emplace_back(hist1d, gen_unique_hist_name());
+    jobs.emplace_back(null_hist, gen_unique_hist_name());
+    jobs.emplace_back(hist2d, gen_unique_hist_name());
+    Root6ConversionOptions options;
+    options.num_threads = 2;
+    const auto results = into_root6_hists(jobs, 2, options);
+    ASSERT_EQ(results.size(), jobs.size(),
+              "Batch conversion should produce one result per job");
+    ASSERT_NOT_NULL(dynamic_cast<const TH1C*>(results[0].hist.get()),
+                    "Batch conversion of a RHist<1, char> should give a TH1C");
+    ASSERT_EQ(results[0].hist->GetName(), jobs[0].name(),
+              "Batch conversion should use the requested name");
+    ASSERT_EQ(results[1].hist.get(), nullptr,
+              "Batch conversion of a null histogram should fail");
+    ASSERT_EQ(results[1].error.empty(), false,
+              "Batch conversion failures should be reported");
+    ASSERT_NOT_NULL(dynamic_cast<const TH2F*>(results[2].hist.get()),
+                    "Batch conversion of a RHist<2, float> should give a TH2F");
+    ASSERT_EQ(results[2].hist->GetEntries(), 1.,
+              "Batch conversion should transfer histogram data");
+    ASSERT_EQ(results[0].hist->GetDirectory(), nullptr,
+              "Batch conversion results should not belong to a directory");
+  }
+
+  // ROOT 7 cannot represent fractional entry counts, which should be
+  // reported as conversion errors
+  {
+    const auto name = gen_unique_hist_name();
+    TH1D scaled(name.c_str(), "", 10, 0., 1.);
+    scaled.SetEntries(2.5);
+    assert_runtime_error([&]() { into_root7_hist(scaled); },
+                         "Fractional entry counts should not be converted "
+                         "to ROOT 7");
+  }
+
+  // Delta exports should match full conversions
+  test_delta_export(rng);
+
+  // Histograms with more than 3 dimensions or sparse occupancy can be
+  // converted into THn and THnSparse
+  test_thn_conversion(rng);
+
   for (size_t i = 0; i < NUM_TEST_RUNS; ++i) {
     // Conversion from ROOT7's default histogram configuration works
     test_conversion<1, char>(rng, {gen_axis_config(rng)});
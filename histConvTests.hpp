@@ -277,6 +277,33 @@ void check_hist_data(const Root7Hist& src,
 }
 
 
+template <typename Root7Hist, typename Root7RoundTrip>
+void check_round_trip(const Root7Hist& src, const Root7RoundTrip& round_trip)
+{
+  const auto& src_stat = src.GetImpl()->GetStat();
+  const auto& round_trip_stat = round_trip.GetImpl()->GetStat();
+  ASSERT_EQ(src_stat.sizeNoOver(), round_trip_stat.sizeNoOver(),
+            "Round trip changed the number of regular bins");
+  ASSERT_EQ(src_stat.sizeUnderOver(), round_trip_stat.sizeUnderOver(),
+            "Round trip changed the number of under- and overflow bins");
+  auto check_bin = [&](int bin) {
+    ASSERT_EQ(src_stat.GetBinContent(bin), round_trip_stat.GetBinContent(bin),
+              "Round trip changed a bin content");
+    ASSERT_EQ(src_stat.GetBinUncertainty(bin),
+              round_trip_stat.GetBinUncertainty(bin),
+              "Round trip changed a bin uncertainty");
+  };
+  for (int bin = 1; bin <= (int)src_stat.sizeNoOver(); ++bin) {
+    check_bin(bin);
+  }
+  for (int bin = -1; bin >= -(int)src_stat.sizeUnderOver(); --bin) {
+    check_bin(bin);
+  }
+  ASSERT_EQ(src.GetEntries(), round_trip.GetEntries(),
+            "Round trip changed the entry count");
+}
+
+
 template <int DIMS,
           class PRECISION,
           template <int D_, class P_> class... STAT>
@@ -309,6 +336,48 @@ void test_conversion(RNG& rng,
 
     // Check that the output histogram contains the same data as the input one
     check_hist_data(src, data.exercizes_overflow, dest);
+
+    // Conversions which go through a plan cache should give the same result,
+    // and reuse the plan when the same axis layout is converted again
+    HistConversionCache cache;
+    for (size_t i = 0; i < 2; ++i) {
+      const std::string cached_name = gen_unique_hist_name();
+      auto cached_dest = into_root6_hist(src, cached_name.c_str(), {&cache});
+      check_hist_config<DIMS>(src_impl, cached_name, cached_dest);
+      check_hist_data(src, data.exercizes_overflow, cached_dest);
+    }
+    ASSERT_EQ(cache.misses(), size_t(1),
+              "Conversion plan should only be computed once");
+    ASSERT_EQ(cache.hits(), size_t(1),
+              "Conversion plan should be reused");
+
+    // A different histogram with the same axis layout should share the plan
+    Source blank(title, axis_configs);
+    const std::string blank_name = gen_unique_hist_name();
+    into_root6_hist(blank, blank_name.c_str(), {&cache});
+    ASSERT_EQ(cache.misses(), size_t(1),
+              "Conversion plan should be shared by same-shaped histograms");
+    ASSERT_EQ(cache.hits(), size_t(2),
+              "Conversion plan should be shared by same-shaped histograms");
+
+    // Refreshing a previously converted histogram in place should have the
+    // same result as a new conversion
+    const std::string refreshed_name = gen_unique_hist_name();
+    auto refreshed_dest = into_root6_hist(blank, refreshed_name.c_str());
+    into_root6_hist(src, refreshed_dest, {&cache});
+    check_hist_config<DIMS>(src_impl, refreshed_name, refreshed_dest);
+    check_hist_data(src, data.exercizes_overflow, refreshed_dest);
+
+    // Refreshing should compute statistics like TH1 does, even when the
+    // output histogram was told to ignore under- and overflow bins
+    refreshed_dest.SetStatOverflows(TH1::EStatOverflows::kIgnore);
+    into_root6_hist(src, refreshed_dest, {&cache});
+    check_stats_recomputation(refreshed_dest);
+
+    // Converting back to ROOT 7 should give back the original histogram
+    const auto round_trip = into_root7_hist(dest);
+    check_hist_config<DIMS>(*round_trip.GetImpl(), name, dest);
+    check_round_trip(src, round_trip);
   }
   catch (const std::runtime_error& e)
   {
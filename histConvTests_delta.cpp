@@ -0,0 +1,71 @@
+// ROOT7 -> ROOT6 histogram delta export tests
+// Extracted from histConvTests.cpp because DeltaExporter needs histConv.hpp
+
+#include "histConv.hpp"
+#include "histConvTests.hpp"
+
+
+// Check that two ROOT 6 histograms have exactly the same data
+static void check_same_data(const TH1& hist, const TH1& ref) {
+  for (Int_t bin = 0; bin < ref.GetNcells(); ++bin) {
+    ASSERT_EQ(hist.GetBinContent(bin), ref.GetBinContent(bin),
+              "Delta export should produce the same bin contents");
+    ASSERT_EQ(hist.GetBinError(bin), ref.GetBinError(bin),
+              "Delta export should produce the same bin errors");
+  }
+  ASSERT_EQ(hist.GetEntries(), ref.GetEntries(),
+            "Delta export should produce the same number of entries");
+  std::array<Double_t, TH1::kNstat> stats, ref_stats;
+  hist.GetStats(stats.data());
+  ref.GetStats(ref_stats.data());
+  ASSERT_EQ(stats, ref_stats,
+            "Delta export should produce the same statistics");
+}
+
+
+void test_delta_export(RNG& rng) {
+  // Use a histogram that spans several statistics blocks and transfer chunks
+  using Source = RExp::RHist<2,
+                             float,
+                             RExp::RHistStatContent,
+                             RExp::RHistStatUncertainty>;
+  Source src({RExp::RAxisConfig(300, -1., 1.),
+              RExp::RAxisConfig(250, -2., 2.)});
+  DeltaExporter<Source> exporter(src);
+  auto gen_point = [&]() -> Source::CoordArray_t {
+    return { gen_double(rng, -1.1, 1.1), gen_double(rng, -2.2, 2.2) };
+  };
+  auto gen_weight = [&]() -> float {
+    return gen_double(rng, WEIGHT_RANGE.first, WEIGHT_RANGE.second);
+  };
+
+  // The first export transfers every bin
+  for (size_t i = 0; i < 10000; ++i) {
+    exporter.Fill(gen_point(), gen_weight());
+  }
+  auto dest = into_root6_hist(src, gen_unique_hist_name().c_str());
+  exporter.export_to(dest);
+  ASSERT_EQ(exporter.num_dirty_blocks(), 0u,
+            "Exporting should reset the set of modified bins");
+  check_same_data(dest,
+                  into_root6_hist(src, gen_unique_hist_name().c_str()));
+
+  // Later exports only transfer the modified bins, but should give the same
+  // results as a full conversion
+  for (size_t i = 0; i < 3; ++i) {
+    exporter.Fill(gen_point(), gen_weight());
+  }
+  ASSERT_EQ(exporter.num_dirty_blocks() <= 3, true,
+            "Few fills should only modify few blocks of bins");
+  exporter.export_to(dest);
+  check_same_data(dest,
+                  into_root6_hist(src, gen_unique_hist_name().c_str()));
+
+  // Exporting into a histogram with a different configuration should fail
+  assert_runtime_error([&]() {
+    Source other({RExp::RAxisConfig(30, -1., 1.),
+                  RExp::RAxisConfig(250, -2., 2.)});
+    auto other_dest = into_root6_hist(other, "bad_delta");
+    exporter.export_to(other_dest);
+  }, "Delta export to a histogram with a different layout should fail");
+}
@@ -0,0 +1,102 @@
+// ROOT7 -> ROOT6 THn and THnSparse conversion tests
+// Extracted from histConvTests.cpp because THn conversions need histConv.hpp
+
+#include "histConv.hpp"
+#include "histConvTests.hpp"
+
+
+// Check that a THn or THnSparse contains the same bin data as a ROOT 7
+// histogram, and return the number of occupied ROOT 7 bins
+template <typename Root7Hist>
+static Long64_t check_thn_data(const Root7Hist& src, THnBase& dest) {
+  constexpr int DIMS = Root7Hist::GetNDim();
+  const auto& impl = *src.GetImpl();
+  const auto& stat = impl.GetStat();
+  using Stat = std::remove_reference_t<decltype(stat)>;
+  ASSERT_EQ(dest.GetNdimensions(), DIMS,
+            "THn should have the same dimension as the source histogram");
+  ASSERT_EQ(dest.GetEntries(), src.GetEntries(),
+            "THn should have the same number of entries");
+
+  Long64_t num_occupied = 0;
+  auto check_bin = [&](int src_bin) {
+    const auto src_local = impl.GetLocalBins(src_bin);
+    std::array<Int_t, DIMS> dest_local;
+    for (int axis = 0; axis < DIMS; ++axis) {
+      const Int_t num_bins = dest.GetAxis(axis)->GetNbins();
+      ASSERT_EQ(num_bins, impl.GetAxis(axis).GetNBinsNoOver(),
+                "THn axes should have the same number of bins");
+      switch (src_local[axis]) {
+        case -1: dest_local[axis] = 0; break;
+        case -2: dest_local[axis] = num_bins + 1; break;
+        default: dest_local[axis] = src_local[axis];
+      }
+    }
+
+    const Double_t content = stat.GetBinContent(src_bin);
+    // Without bin uncertainties, THn treats bin contents as the sum of
+    // squared weights, as the conversion does
+    Double_t sumw2 = content;
+    if constexpr (Stat::HasBinUncertainty()) {
+      sumw2 = stat.GetSumOfSquaredWeights(src_bin);
+    }
+    if ((content != 0.) || (sumw2 != 0.)) ++num_occupied;
+    const Long64_t dest_bin = dest.GetBin(dest_local.data(), kFALSE);
+    if (dest_bin < 0) {
+      ASSERT_EQ(content, 0., "THnSparse should record all non-empty bins");
+      ASSERT_EQ(sumw2, 0., "THnSparse should record all non-empty bins");
+      return;
+    }
+    ASSERT_EQ(dest.GetBinContent(dest_bin), content,
+              "THn should have the same bin contents");
+    ASSERT_EQ(dest.GetBinError2(dest_bin), sumw2,
+              "THn should have the same bin errors");
+  };
+  for (int bin = 1; bin <= (int)stat.sizeNoOver(); ++bin) check_bin(bin);
+  for (int bin = -1; bin >= -(int)stat.sizeUnderOver(); --bin) check_bin(bin);
+  return num_occupied;
+}
+
+
+void test_thn_conversion(RNG& rng) {
+  // Histograms with more than 3 dimensions are converted into THn, and
+  // optionally THnSparse, with all axis kinds supported
+  using Source4D = RExp::RHist<4,
+                               double,
+                               RExp::RHistStatContent,
+                               RExp::RHistStatUncertainty>;
+  Source4D src4d({RExp::RAxisConfig(6, 0., 1.),
+                  RExp::RAxisConfig({0., 0.1, 0.5, 1.}),
+                  RExp::RAxisConfig(5, -1., 1.),
+                  RExp::RAxisConfig(4, -2., 2.)});
+  for (size_t i = 0; i < 200; ++i) {
+    src4d.Fill({gen_double(rng, -0.1, 1.1),
+                gen_double(rng, -0.1, 1.1),
+                gen_double(rng, -1.1, 1.1),
+                gen_double(rng, -2.2, 2.2)},
+               gen_double(rng, WEIGHT_RANGE.first, WEIGHT_RANGE.second));
+  }
+  std::unique_ptr<THnD> dense =
+    into_root6_hist(src4d, gen_unique_hist_name().c_str());
+  check_thn_data(src4d, *dense);
+  std::unique_ptr<THnSparseD> sparse4d =
+    into_root6_sparse_hist(src4d, gen_unique_hist_name().c_str());
+  const Long64_t num_occupied4d = check_thn_data(src4d, *sparse4d);
+  ASSERT_EQ(sparse4d->GetNbins(), num_occupied4d,
+            "THnSparse should only allocate the non-empty bins");
+
+  // Sparse conversion of a huge, mostly empty histogram should only allocate
+  // the bins that were filled
+  RExp::RHist<2, float> src2d({RExp::RAxisConfig(1000, -1., 1.),
+                               RExp::RAxisConfig(1000, -1., 1.)});
+  for (size_t i = 0; i < 10; ++i) {
+    src2d.Fill({gen_double(rng, -1., 1.), gen_double(rng, -1., 1.)});
+  }
+  std::unique_ptr<THnSparseF> sparse2d =
+    into_root6_sparse_hist(src2d, gen_unique_hist_name().c_str());
+  const Long64_t num_occupied2d = check_thn_data(src2d, *sparse2d);
+  ASSERT_EQ(sparse2d->GetNbins(), num_occupied2d,
+            "THnSparse should only allocate the non-empty bins");
+  ASSERT_EQ(num_occupied2d <= 10, true,
+            "Few fills should only occupy few bins");
+}
@@ -3,10 +3,13 @@
 
 #include "ROOT/RAxis.hxx"
 #include "TAxis.h"
+#include "TH1.h"
 #include "THashList.h"
 #include "TObjString.h"
 
 #include <algorithm>
+#include <array>
+#include <cmath>
 #include <exception>
 #include <iostream>
 #include <string>
@@ -278,3 +281,16 @@ void check_axis_config(const RExp::RAxisBase& src, TAxis& dest) {
     delete labels_iter_ptr;
   }
 }
+
+
+void check_stats_recomputation(TH1& hist) {
+  std::array<Double_t, TH1::kNstat> stats{};
+  hist.GetStats(stats.data());
+  hist.ResetStats();
+  std::array<Double_t, TH1::kNstat> recomputed_stats{};
+  hist.GetStats(recomputed_stats.data());
+  for (size_t i = 0; i < stats.size(); ++i) {
+    ASSERT_CLOSE(stats[i], recomputed_stats[i], 1e-6,
+                 "Global statistics differ from what TH1 would compute");
+  }
+}
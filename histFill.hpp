@@ -0,0 +1,1651 @@
+// Alternative strategies for filling ROOT 7 histograms from multiple threads
+//
+// ROOT 7 provides RHistConcurrentFillManager, which serializes all fills to a
+// histogram on one mutex. The tools in this header trade memory or
+// flexibility for less synchronization, see fillBench for how they compare.
+
+#pragma once
+
+#include "histStats.hpp"
+
+#include "ROOT/RAxis.hxx"
+#include "ROOT/RHist.hxx"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+
+// === THREAD-LOCAL REPLICAS, MERGED AT THE END ===
+
+// Hands out private copies ("replicas") of a master histogram, which threads
+// can fill without any synchronization, then merges them back into the master
+//
+// This is the fastest strategy as long as histograms are small enough to be
+// replicated once per thread, and the master histogram only needs to be up to
+// date at the end of the run.
+//
+// Only bin contents and bin uncertainties are merged, so HIST should not
+// record other statistics (e.g. RHistDataMomentUncert) that need to be
+// accurate in the master histogram.
+//
+template <class HIST>
+class ReplicaFillManager
+{
+public:
+  // Set up a manager for some master histogram, which must outlive it
+  explicit ReplicaFillManager(HIST& master) : m_master(master) {}
+
+  // Create a new replica, initially empty. Can be called from any thread.
+  //
+  // The replica may be filled by one thread at a time until the next call
+  // to merge(), which invalidates it. The master histogram must not be
+  // modified while replicas are being created.
+  //
+  HIST& make_replica();
+
+  // Merge all replicas into the master histogram, then discard them
+  //
+  // Must be called once all threads are done filling their replicas. The
+  // replicas are summed pairwise in a parallel tree reduction, so that
+  // merging T replicas takes log2(T) bin-wise additions on the critical path.
+  // Entry counts are merged in O(1), see add_entries.
+  //
+  void merge();
+
+private:
+  // Bin data of a histogram
+  static auto& stat(HIST& hist) { return hist.GetImpl()->GetStat(); }
+
+  HIST& m_master;
+  std::mutex m_replicas_mutex;
+  std::vector<std::unique_ptr<HIST>> m_replicas;
+};
+
+
+template <class HIST>
+HIST& ReplicaFillManager<HIST>::make_replica()
+{
+  // ROOT 7 histograms cannot be reset, so replicas start as a copy of the
+  // master whose bins and entry count are then zeroed
+  auto replica = std::make_unique<HIST>(m_master);
+  auto& replica_stat = stat(*replica);
+  clear_bin_data(replica_stat);
+  add_entries(replica_stat, -replica_stat.GetEntries());
+  std::lock_guard<std::mutex> lock{m_replicas_mutex};
+  m_replicas.push_back(std::move(replica));
+  return *m_replicas.back();
+}
+
+
+template <class HIST>
+void ReplicaFillManager<HIST>::merge()
+{
+  std::lock_guard<std::mutex> lock{m_replicas_mutex};
+  const size_t num_replicas = m_replicas.size();
+  if (num_replicas == 0) return;
+
+  // Tree reduction: at each level, replica i absorbs replica i + stride
+  std::vector<std::thread> threads;
+  for (size_t stride = 1; stride < num_replicas; stride *= 2) {
+    threads.clear();
+    for (size_t i = 0; i + stride < num_replicas; i += 2 * stride) {
+      threads.emplace_back([this, i, stride] {
+        auto& to = stat(*m_replicas[i]);
+        const auto& from = stat(*m_replicas[i + stride]);
+        add_bin_data(to, from);
+        add_entries(to, from.GetEntries());
+      });
+    }
+    for (auto& thread: threads) thread.join();
+  }
+
+  // Move the sum of all replicas into the master histogram
+  const auto& sum = stat(*m_replicas.front());
+  add_bin_data(stat(m_master), sum);
+  add_entries(stat(m_master), sum.GetEntries());
+  m_replicas.clear();
+}
+
+
+// === RELAXED ATOMIC BIN DATA ===
+
+// Bin data type whose operations compile down to relaxed atomic operations
+//
+// RHist<DIMS, RelaxedAtomic<T>> can have its bins filled by many threads at
+// once without a mutex, through RelaxedAtomicFillManager (RHist::Fill cannot
+// be used for that, as it also updates a non-atomic entry count). Relaxed
+// ordering is enough because bins are only read after the filling threads
+// have been joined or otherwise synchronized with.
+//
+// Integer bins are incremented with fetch_add, and floating-point bins with a
+// compare-and-swap loop since std::atomic<float> has no fetch_add in C++17.
+//
+template <typename T>
+class RelaxedAtomic
+{
+public:
+  using value_type = T;
+
+  RelaxedAtomic() : m_value{T()} {}
+
+  template <typename U,
+            typename = std::enable_if_t<std::is_arithmetic_v<U>>>
+  RelaxedAtomic(U value) : m_value{T(value)} {}
+
+  // std::vector needs copies, which are not atomic as a whole
+  RelaxedAtomic(const RelaxedAtomic& other) : m_value{other.load()} {}
+  RelaxedAtomic& operator=(const RelaxedAtomic& other) {
+    store(other.load());
+    return *this;
+  }
+
+  RelaxedAtomic& operator=(T value) {
+    store(value);
+    return *this;
+  }
+
+  operator T() const { return load(); }
+
+  RelaxedAtomic& operator+=(T increment) {
+    if constexpr (std::is_integral_v<T>) {
+      m_value.fetch_add(increment, std::memory_order_relaxed);
+    } else {
+      T old_value = load();
+      while (!m_value.compare_exchange_weak(old_value,
+                                            old_value + increment,
+                                            std::memory_order_relaxed)) {}
+    }
+    return *this;
+  }
+
+private:
+  T load() const { return m_value.load(std::memory_order_relaxed); }
+  void store(T value) { m_value.store(value, std::memory_order_relaxed); }
+
+  std::atomic<T> m_value;
+};
+
+
+// Lets many threads fill an RHist<DIMS, RelaxedAtomic<T>> at the same time
+//
+// Bins are updated directly with relaxed atomic operations. Each filler only
+// counts its entries, and adds them to the histogram's entry count (an O(1)
+// operation under a mutex) when it is flushed or destroyed. So the entry
+// count is only correct once all fillers are gone.
+//
+// HIST should only record bin contents and bin uncertainties, and must not
+// have growable axes.
+//
+template <class HIST>
+class RelaxedAtomicFillManager
+{
+public:
+  using CoordArray_t = typename HIST::CoordArray_t;
+  using Value_t = typename HIST::Weight_t::value_type;
+
+  // Set up a manager for some histogram, which must outlive it
+  explicit RelaxedAtomicFillManager(HIST& hist) : m_hist(hist) {}
+
+  // Per-thread filling interface
+  class Filler
+  {
+  public:
+    explicit Filler(RelaxedAtomicFillManager& manager)
+      : m_manager(manager)
+      , m_impl(*manager.m_hist.GetImpl())
+    {}
+
+    Filler(const Filler&) = delete;
+    Filler& operator=(const Filler&) = delete;
+
+    ~Filler() { Flush(); }
+
+    // Insert a data point into the histogram
+    void Fill(const CoordArray_t& x, Value_t weight = 1) {
+      auto& stat = m_impl.GetStat();
+      using Stat = std::remove_reference_t<decltype(stat)>;
+      const int bin = m_impl.GetBinIndex(x);
+      stat.GetBinContent(bin) += weight;
+      if constexpr (Stat::HasBinUncertainty()) {
+        stat.GetSumOfSquaredWeights(bin) += weight * weight;
+      }
+      ++m_entries;
+    }
+
+    // Commit the entries recorded so far to the histogram's entry count
+    void Flush() {
+      m_manager.commit_entries(m_entries);
+      m_entries = 0;
+    }
+
+  private:
+    RelaxedAtomicFillManager& m_manager;
+    typename HIST::ImplBase_t& m_impl;
+    int64_t m_entries = 0;
+  };
+
+  // Create a filler for the current thread
+  Filler MakeFiller() { return Filler{*this}; }
+
+private:
+  void commit_entries(int64_t num_entries) {
+    if (num_entries == 0) return;
+    std::lock_guard<std::mutex> lock{m_entries_mutex};
+    add_entries(m_hist.GetImpl()->GetStat(), num_entries);
+  }
+
+  HIST& m_hist;
+  std::mutex m_entries_mutex;
+};
+
+
+// === STRIPED LOCKING ===
+
+// Variant of RHistConcurrentFillManager which splits the bins of the
+// histogram into "stripes", each protected by its own mutex
+//
+// Fillers compute the bin index of each data point as it comes in, and buffer
+// it along with its weight, partitioned by stripe. Flushing a filler's buffer
+// then only locks the stripes that it needs to update, starting with those
+// that no other filler is currently updating. So concurrent flushes mostly
+// proceed in parallel, instead of waiting for each other on a single mutex.
+//
+// Stripes interleave blocks of STRIPE_BLOCK_BINS consecutive bins, which
+// spreads data hot spots over several stripes while keeping the bins of
+// different stripes in different cache lines.
+//
+// HIST should only record bin contents and bin uncertainties, and must not
+// have growable axes. Each filler adds its entries to the histogram's entry
+// count when it is destroyed.
+//
+template <class HIST>
+class StripedFillManager
+{
+public:
+  using CoordArray_t = typename HIST::CoordArray_t;
+  using Weight_t = typename HIST::Weight_t;
+
+  // Number of consecutive bins in each block of a stripe
+  static constexpr int STRIPE_BLOCK_BINS = 16;
+
+  // Set up a manager for some histogram, which must outlive it, with a
+  // certain number of stripes and filler buffer size (in data points)
+  StripedFillManager(HIST& hist,
+                     size_t num_stripes,
+                     size_t buffer_size = 1024)
+    : m_hist(hist)
+    , m_num_regular_bins(hist.GetImpl()->GetStat().sizeNoOver())
+    , m_buffer_size(std::max(buffer_size, size_t(1)))
+    , m_stripes(num_stripes)
+  {}
+
+  // Per-thread filling interface
+  class Filler
+  {
+  public:
+    explicit Filler(StripedFillManager& manager)
+      : m_manager(manager)
+      , m_impl(*manager.m_hist.GetImpl())
+      , m_buffers(manager.m_stripes.size())
+      , m_first_stripe(manager.m_next_first_stripe.fetch_add(1)
+                       % manager.m_stripes.size())
+    {}
+
+    Filler(const Filler&) = delete;
+    Filler& operator=(const Filler&) = delete;
+
+    ~Filler() {
+      Flush();
+      m_manager.commit_entries(m_entries);
+    }
+
+    // Buffer a data point, flushing the buffer if it is full
+    void Fill(const CoordArray_t& x, Weight_t weight = 1.) {
+      const int bin = m_impl.GetBinIndex(x);
+      m_buffers[m_manager.stripe_of(bin)].push_back({bin, weight});
+      ++m_entries;
+      if (++m_num_buffered == m_manager.m_buffer_size) Flush();
+    }
+
+    // Apply the buffered data points to the histogram's bins
+    void Flush();
+
+  private:
+    struct BufferedFill
+    {
+      int bin;
+      Weight_t weight;
+    };
+
+    StripedFillManager& m_manager;
+    typename HIST::ImplBase_t& m_impl;
+    std::vector<std::vector<BufferedFill>> m_buffers;
+    size_t m_first_stripe;
+    size_t m_num_buffered = 0;
+    int64_t m_entries = 0;
+  };
+
+  // Create a filler for the current thread
+  Filler MakeFiller() { return Filler{*this}; }
+
+private:
+  // Stripe which a bin belongs to
+  size_t stripe_of(int bin) const {
+    const int position = (bin > 0) ? (bin - 1)
+                                   : (m_num_regular_bins - bin - 1);
+    return (position / STRIPE_BLOCK_BINS) % m_stripes.size();
+  }
+
+  // Add to the histogram's entry count, which is O(1) and does not touch
+  // the bins, so it has its own lock rather than taking a stripe's
+  void commit_entries(int64_t num_entries) {
+    if (num_entries == 0) return;
+    std::lock_guard<std::mutex> lock{m_entries_mutex};
+    add_entries(m_hist.GetImpl()->GetStat(), num_entries);
+  }
+
+  // Stripe locks are kept on separate cache lines
+  struct alignas(64) Stripe
+  {
+    std::mutex mutex;
+  };
+
+  HIST& m_hist;
+  int m_num_regular_bins;
+  size_t m_buffer_size;
+  std::vector<Stripe> m_stripes;
+  std::mutex m_entries_mutex;
+  std::atomic<size_t> m_next_first_stripe{0};
+};
+
+
+template <class HIST>
+void StripedFillManager<HIST>::Filler::Flush()
+{
+  auto& stat = m_impl.GetStat();
+  using Stat = std::remove_reference_t<decltype(stat)>;
+  const size_t num_stripes = m_buffers.size();
+
+  // Go through stripes whose lock is free first, then wait for the others.
+  // Fillers start at different stripes to avoid convoys.
+  for (const bool blocking: {false, true}) {
+    for (size_t i = 0; i < num_stripes; ++i) {
+      const size_t stripe = (m_first_stripe + i) % num_stripes;
+      auto& buffer = m_buffers[stripe];
+      if (buffer.empty()) continue;
+      auto& mutex = m_manager.m_stripes[stripe].mutex;
+      if (blocking) {
+        mutex.lock();
+      } else if (!mutex.try_lock()) {
+        continue;
+      }
+      std::lock_guard<std::mutex> lock{mutex, std::adopt_lock};
+      for (const auto& fill: buffer) {
+        stat.GetBinContent(fill.bin) += fill.weight;
+        if constexpr (Stat::HasBinUncertainty()) {
+          stat.GetSumOfSquaredWeights(fill.bin) += fill.weight * fill.weight;
+        }
+      }
+      buffer.clear();
+    }
+  }
+  m_num_buffered = 0;
+}
+
+
+// === LOCK-FREE HAND-OFF TO A MERGER THREAD ===
+
+// Variant of RHistConcurrentFillManager where fillers never touch the
+// histogram: full buffers are handed off through a lock-free queue to a
+// dedicated merger thread, which inserts them into the histogram with FillN.
+//
+// Each filler owns a fixed pool of buffers, which the merger thread gives
+// back once they have been merged, so memory usage is bounded. If the merger
+// falls behind and a filler runs out of buffers, that filler waits for one to
+// come back (backpressure) instead of allocating more.
+//
+// Buffers go through the lock-free lists as long as there is work to be done.
+// A mutex and condition variable are only used to put the merger thread to
+// sleep when the queue is empty, and fillers to sleep when they have no free
+// buffer, so that waiting threads do not steal CPU time from working ones.
+// Fillers must be destroyed before the manager, whose destructor merges the
+// remaining buffers and joins the merger thread.
+//
+template <class HIST>
+class QueuedFillManager
+{
+public:
+  using CoordArray_t = typename HIST::CoordArray_t;
+  using Weight_t = typename HIST::Weight_t;
+
+  // Set up a manager for some histogram, which must outlive it, with a
+  // certain buffer size (in data points) and number of buffers per filler
+  explicit QueuedFillManager(HIST& hist,
+                             size_t buffer_size = 1024,
+                             size_t buffers_per_filler = 4)
+    : m_hist(hist)
+    , m_buffer_size(std::max(buffer_size, size_t(1)))
+    , m_buffers_per_filler(std::max(buffers_per_filler, size_t(1)))
+    , m_merger([this] { merge_loop(); })
+  {}
+
+  QueuedFillManager(const QueuedFillManager&) = delete;
+  QueuedFillManager& operator=(const QueuedFillManager&) = delete;
+
+  ~QueuedFillManager() {
+    m_stop.store(true, std::memory_order_release);
+    wake(m_merger_mutex, m_merger_cv);
+    m_merger.join();
+  }
+
+private:
+  struct FillerPool;
+
+  // Buffer of data points, which is also a node of the lock-free lists
+  struct FillBuffer
+  {
+    std::vector<CoordArray_t> coords;
+    std::vector<Weight_t> weights;
+    FillerPool* owner;
+    FillBuffer* next = nullptr;
+  };
+
+  // Buffers owned by a filler, list of those which it may use again, and
+  // means for the filler to sleep until that list becomes non-empty
+  //
+  // Pools outlive their filler, as the merger thread may still be waking
+  // it up after giving back its last buffer. Only their buffers are freed
+  // when the filler is destroyed.
+  //
+  struct FillerPool
+  {
+    std::vector<std::unique_ptr<FillBuffer>> buffers;
+    std::atomic<FillBuffer*> free_head{nullptr};
+    std::mutex mutex;
+    std::condition_variable cv;
+  };
+
+public:
+  // Per-thread filling interface
+  class Filler
+  {
+  public:
+    explicit Filler(QueuedFillManager& manager);
+
+    Filler(const Filler&) = delete;
+    Filler& operator=(const Filler&) = delete;
+
+    ~Filler();
+
+    // Buffer a data point, handing off the buffer if it is full
+    void Fill(const CoordArray_t& x, Weight_t weight = 1.) {
+      m_buffer->coords.push_back(x);
+      m_buffer->weights.push_back(weight);
+      if (m_buffer->coords.size() == m_manager.m_buffer_size) Flush();
+    }
+
+    // Hand off the buffered data points to the merger thread
+    void Flush();
+
+  private:
+    // Take a free buffer, waiting for the merger thread if there is none
+    FillBuffer* acquire_buffer();
+
+    // Move the buffers given back by the merger thread to m_free_list,
+    // sleeping until there are some if "wait" is set
+    void collect_free_buffers(bool wait = false);
+
+    QueuedFillManager& m_manager;
+    FillerPool* m_pool;
+    FillBuffer* m_free_list = nullptr;
+    size_t m_num_free = 0;
+    FillBuffer* m_buffer = nullptr;
+  };
+
+  // Create a filler for the current thread
+  Filler MakeFiller() { return Filler{*this}; }
+
+private:
+  // Push a buffer on a lock-free list. Lists are only ever popped as a whole
+  // with an atomic exchange, which avoids the ABA problem. Returns whether
+  // the list was empty, in which case its consumer may be asleep.
+  static bool push(std::atomic<FillBuffer*>& head, FillBuffer* buffer) {
+    // The buffer belongs to the consumer once pushed, so it must not be
+    // read afterwards to find out what the list head used to be
+    FillBuffer* old_head = head.load(std::memory_order_relaxed);
+    do {
+      buffer->next = old_head;
+    } while (!head.compare_exchange_weak(old_head,
+                                         buffer,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed));
+    return old_head == nullptr;
+  }
+
+  // Wake up a thread sleeping on a condition variable. Going through the
+  // mutex ensures that the wake-up is not lost if that thread was about to
+  // sleep, having checked its wake-up condition just before.
+  static void wake(std::mutex& mutex, std::condition_variable& cv) {
+    { std::lock_guard<std::mutex> lock{mutex}; }
+    cv.notify_one();
+  }
+
+  // Set up the buffer pool of a new filler
+  FillerPool* make_pool() {
+    std::lock_guard<std::mutex> lock{m_pools_mutex};
+    m_pools.push_back(std::make_unique<FillerPool>());
+    return m_pools.back().get();
+  }
+
+  // Hand off a full buffer to the merger thread
+  void submit(FillBuffer* buffer) {
+    if (push(m_full_head, buffer)) wake(m_merger_mutex, m_merger_cv);
+  }
+
+  // Work of the merger thread
+  void merge_loop();
+
+  HIST& m_hist;
+  size_t m_buffer_size;
+  size_t m_buffers_per_filler;
+  std::atomic<FillBuffer*> m_full_head{nullptr};
+  std::atomic<bool> m_stop{false};
+  std::mutex m_merger_mutex;
+  std::condition_variable m_merger_cv;
+  std::mutex m_pools_mutex;
+  std::vector<std::unique_ptr<FillerPool>> m_pools;
+  std::thread m_merger;  // Must be initialized last
+};
+
+
+template <class HIST>
+QueuedFillManager<HIST>::Filler::Filler(
+  QueuedFillManager& manager
+)
+  : m_manager(manager)
+  , m_pool(manager.make_pool())
+{
+  for (size_t i = 0; i < manager.m_buffers_per_filler; ++i) {
+    auto buffer = std::make_unique<FillBuffer>();
+    buffer->coords.reserve(manager.m_buffer_size);
+    buffer->weights.reserve(manager.m_buffer_size);
+    buffer->owner = m_pool;
+    buffer->next = m_free_list;
+    m_free_list = buffer.get();
+    ++m_num_free;
+    m_pool->buffers.push_back(std::move(buffer));
+  }
+  m_buffer = acquire_buffer();
+}
+
+
+template <class HIST>
+QueuedFillManager<HIST>::Filler::~Filler()
+{
+  // Hand off the remaining data points, if any
+  if (!m_buffer->coords.empty()) {
+    m_manager.submit(m_buffer);
+  } else {
+    m_buffer->next = m_free_list;
+    m_free_list = m_buffer;
+    ++m_num_free;
+  }
+
+  // Wait for the merger thread to be done with our buffers
+  while (m_num_free < m_pool->buffers.size()) {
+    collect_free_buffers(true);
+  }
+  m_pool->buffers.clear();
+}
+
+
+template <class HIST>
+void QueuedFillManager<HIST>::Filler::Flush()
+{
+  if (m_buffer->coords.empty()) return;
+  m_manager.submit(m_buffer);
+  m_buffer = acquire_buffer();
+}
+
+
+template <class HIST>
+auto QueuedFillManager<HIST>::Filler::acquire_buffer()
+  -> FillBuffer*
+{
+  while (m_free_list == nullptr) collect_free_buffers(true);
+  FillBuffer* const buffer = m_free_list;
+  m_free_list = buffer->next;
+  --m_num_free;
+  return buffer;
+}
+
+
+template <class HIST>
+void QueuedFillManager<HIST>::Filler::collect_free_buffers(bool wait)
+{
+  if (wait && (m_pool->free_head.load(std::memory_order_relaxed) == nullptr)) {
+    std::unique_lock<std::mutex> lock{m_pool->mutex};
+    m_pool->cv.wait(lock, [&] {
+      return m_pool->free_head.load(std::memory_order_relaxed) != nullptr;
+    });
+  }
+  FillBuffer* buffer =
+    m_pool->free_head.exchange(nullptr, std::memory_order_acquire);
+  while (buffer != nullptr) {
+    FillBuffer* const next = buffer->next;
+    buffer->next = m_free_list;
+    m_free_list = buffer;
+    ++m_num_free;
+    buffer = next;
+  }
+}
+
+
+template <class HIST>
+void QueuedFillManager<HIST>::merge_loop()
+{
+  while (true) {
+    // Check if we've been asked to stop before looking at the queue, so
+    // that buffers which were queued before the stop request get merged
+    const bool stopping = m_stop.load(std::memory_order_acquire);
+    FillBuffer* buffer =
+      m_full_head.exchange(nullptr, std::memory_order_acquire);
+    if (buffer == nullptr) {
+      if (stopping) return;
+
+      // Sleep until a filler submits a buffer or the manager is destroyed
+      std::unique_lock<std::mutex> lock{m_merger_mutex};
+      m_merger_cv.wait(lock, [&] {
+        return (m_full_head.load(std::memory_order_relaxed) != nullptr)
+               || m_stop.load(std::memory_order_relaxed);
+      });
+      continue;
+    }
+
+    // Merge the queued buffers and give them back to their owners
+    while (buffer != nullptr) {
+      FillBuffer* const next = buffer->next;
+      m_hist.FillN(buffer->coords, buffer->weights);
+      buffer->coords.clear();
+      buffer->weights.clear();
+      FillerPool& owner = *buffer->owner;
+      if (push(owner.free_head, buffer)) wake(owner.mutex, owner.cv);
+      buffer = next;
+    }
+  }
+}
+
+
+// === UNWEIGHTED BUFFERED FILLING ===
+
+// Variant of RHistBufferedFill for unit-weight data points, which only
+// buffers coordinates and flushes them with the FillN(coords) overload
+//
+// RHistBufferedFill also records a weight per data point, which costs memory
+// traffic for nothing when all weights are 1. Unlike RHistBufferedFill (as of
+// ROOT 6.18), flushing resets the buffer, destruction flushes it, and the
+// buffer size is chosen at runtime.
+//
+template <class HIST>
+class UnweightedBufferedFill
+{
+public:
+  using CoordArray_t = typename HIST::CoordArray_t;
+
+  // Set up buffered filling of some histogram, which must outlive us, with
+  // a certain buffer size (in data points)
+  explicit UnweightedBufferedFill(HIST& hist, size_t size = 1024)
+    : m_hist(hist)
+    , m_coords(std::max(size, size_t(1)))
+  {}
+
+  UnweightedBufferedFill(const UnweightedBufferedFill&) = delete;
+  UnweightedBufferedFill& operator=(const UnweightedBufferedFill&) = delete;
+
+  ~UnweightedBufferedFill() { Flush(); }
+
+  // Buffer a data point, flushing the buffer if it is full
+  void Fill(const CoordArray_t& x) {
+    m_coords[m_cursor++] = x;
+    if (m_cursor == m_coords.size()) Flush();
+  }
+
+  // Insert the buffered data points into the histogram
+  void Flush() {
+    if (m_cursor == 0) return;
+    m_hist.FillN(std::span<const CoordArray_t>(m_coords.data(), m_cursor));
+    m_cursor = 0;
+  }
+
+private:
+  HIST& m_hist;
+  std::vector<CoordArray_t> m_coords;
+  size_t m_cursor = 0;
+};
+
+
+// Variant of RHistConcurrentFillManager for unit-weight data points, whose
+// fillers only buffer coordinates like UnweightedBufferedFill
+template <class HIST>
+class UnweightedConcurrentFillManager
+{
+public:
+  using CoordArray_t = typename HIST::CoordArray_t;
+
+  // Set up a manager for some histogram, which must outlive it, with a
+  // certain filler buffer size (in data points)
+  explicit UnweightedConcurrentFillManager(HIST& hist,
+                                           size_t buffer_size = 1024)
+    : m_hist(hist)
+    , m_buffer_size(buffer_size)
+  {}
+
+  // Thread-safe insertion of unit-weight data points into the histogram
+  void FillN(const std::span<const CoordArray_t> xN) {
+    std::lock_guard<std::mutex> lock{m_hist_mutex};
+    m_hist.FillN(xN);
+  }
+
+  // Per-thread filling interface
+  using Filler = UnweightedBufferedFill<UnweightedConcurrentFillManager>;
+
+  // Create a filler for the current thread
+  Filler MakeFiller() { return Filler{*this, m_buffer_size}; }
+
+private:
+  HIST& m_hist;
+  std::mutex m_hist_mutex;
+  size_t m_buffer_size;
+};
+
+
+// === ADAPTIVE BUFFER SIZING ===
+
+// Variant of RHistConcurrentFillManager whose fillers adjust their buffer
+// size at runtime, depending on how contended the histogram's mutex is
+//
+// The optimal buffer size depends on contention: small buffers are best for
+// a histogram that is mostly filled by one thread, while many threads need
+// large buffers to avoid waiting for each other. So fillers start with a
+// buffer of min_size data points, and...
+//
+// - When a flush finds the mutex locked, the buffer size is doubled (up to
+//   max_size) and the filler keeps buffering instead of waiting. Only a full
+//   buffer of max_size data points waits for the mutex.
+// - After SHRINK_STREAK consecutive flushes that found the mutex unlocked,
+//   the buffer size is halved (down to min_size).
+//
+template <class HIST>
+class AdaptiveConcurrentFillManager
+{
+public:
+  using CoordArray_t = typename HIST::CoordArray_t;
+  using Weight_t = typename HIST::Weight_t;
+
+  // Number of uncontended flushes after which buffers shrink
+  static constexpr size_t SHRINK_STREAK = 16;
+
+  // Set up a manager for some histogram, which must outlive it, with
+  // certain bounds on the buffer size of fillers
+  explicit AdaptiveConcurrentFillManager(HIST& hist,
+                                         size_t min_size = 64,
+                                         size_t max_size = 64 * 1024)
+    : m_hist(hist)
+    , m_min_size(std::max(min_size, size_t(1)))
+    , m_max_size(std::max(max_size, m_min_size))
+  {}
+
+  // Per-thread filling interface
+  class Filler
+  {
+  public:
+    explicit Filler(AdaptiveConcurrentFillManager& manager)
+      : m_manager(manager)
+      , m_buffer_size(manager.m_min_size)
+    {
+      m_coords.reserve(m_buffer_size);
+      m_weights.reserve(m_buffer_size);
+    }
+
+    Filler(const Filler&) = delete;
+    Filler& operator=(const Filler&) = delete;
+
+    ~Filler();
+
+    // Buffer a data point, trying to flush the buffer if it is full
+    void Fill(const CoordArray_t& x, Weight_t weight = 1.) {
+      m_coords.push_back(x);
+      m_weights.push_back(weight);
+      if (m_coords.size() >= m_buffer_size) try_flush();
+    }
+
+    // Insert the buffered data points into the histogram, waiting for the
+    // mutex if needed
+    void Flush();
+
+    // Current buffer size, in data points
+    size_t buffer_size() const { return m_buffer_size; }
+
+    // Fraction of flushes which found the mutex locked so far
+    double contention_rate() const {
+      return (m_num_flushes == 0) ? 0. : double(m_num_contended)
+                                           / m_num_flushes;
+    }
+
+  private:
+    // Flush if the mutex is free, otherwise grow the buffer (if possible)
+    void try_flush();
+
+    // Insert the buffered data points, with the mutex held
+    void flush_locked();
+
+    AdaptiveConcurrentFillManager& m_manager;
+    std::vector<CoordArray_t> m_coords;
+    std::vector<Weight_t> m_weights;
+    size_t m_buffer_size;
+    size_t m_uncontended_streak = 0;
+    size_t m_num_flushes = 0;
+    size_t m_num_contended = 0;
+  };
+
+  // Create a filler for the current thread
+  Filler MakeFiller() { return Filler{*this}; }
+
+  // Fraction of flushes which found the mutex locked, across all fillers
+  // that have been destroyed so far
+  double contention_rate() const {
+    const size_t num_flushes = m_num_flushes.load(std::memory_order_relaxed);
+    return (num_flushes == 0)
+           ? 0.
+           : double(m_num_contended.load(std::memory_order_relaxed))
+               / num_flushes;
+  }
+
+  // Average buffer size of fillers that have been destroyed so far, at the
+  // time of their destruction
+  double mean_buffer_size() const {
+    const size_t num_fillers = m_num_fillers.load(std::memory_order_relaxed);
+    return (num_fillers == 0)
+           ? 0.
+           : double(m_total_buffer_size.load(std::memory_order_relaxed))
+               / num_fillers;
+  }
+
+private:
+  HIST& m_hist;
+  std::mutex m_hist_mutex;
+  size_t m_min_size;
+  size_t m_max_size;
+
+  // Statistics from destroyed fillers
+  std::atomic<size_t> m_num_flushes{0};
+  std::atomic<size_t> m_num_contended{0};
+  std::atomic<size_t> m_num_fillers{0};
+  std::atomic<size_t> m_total_buffer_size{0};
+};
+
+
+template <class HIST>
+AdaptiveConcurrentFillManager<HIST>::Filler::~Filler()
+{
+  Flush();
+  m_manager.m_num_flushes.fetch_add(m_num_flushes,
+                                    std::memory_order_relaxed);
+  m_manager.m_num_contended.fetch_add(m_num_contended,
+                                      std::memory_order_relaxed);
+  m_manager.m_num_fillers.fetch_add(1, std::memory_order_relaxed);
+  m_manager.m_total_buffer_size.fetch_add(m_buffer_size,
+                                          std::memory_order_relaxed);
+}
+
+
+template <class HIST>
+void AdaptiveConcurrentFillManager<HIST>::Filler::Flush()
+{
+  if (m_coords.empty()) return;
+  std::lock_guard<std::mutex> lock{m_manager.m_hist_mutex};
+  flush_locked();
+}
+
+
+template <class HIST>
+void AdaptiveConcurrentFillManager<HIST>::Filler::try_flush()
+{
+  ++m_num_flushes;
+  std::unique_lock<std::mutex> lock{m_manager.m_hist_mutex,
+                                    std::try_to_lock};
+  if (lock.owns_lock()) {
+    // Uncontended: shrink the buffer after a long enough streak
+    if (++m_uncontended_streak >= SHRINK_STREAK) {
+      m_buffer_size = std::max(m_buffer_size / 2, m_manager.m_min_size);
+      m_uncontended_streak = 0;
+    }
+    flush_locked();
+    return;
+  }
+
+  // Contended: grow the buffer and keep filling, unless it is already as
+  // large as allowed, in which case we have no choice but to wait
+  ++m_num_contended;
+  m_uncontended_streak = 0;
+  if (m_buffer_size < m_manager.m_max_size) {
+    m_buffer_size = std::min(2 * m_buffer_size, m_manager.m_max_size);
+    m_coords.reserve(m_buffer_size);
+    m_weights.reserve(m_buffer_size);
+  } else {
+    lock.lock();
+    flush_locked();
+  }
+}
+
+
+template <class HIST>
+void AdaptiveConcurrentFillManager<HIST>::Filler::flush_locked()
+{
+  m_manager.m_hist.FillN(m_coords, m_weights);
+  m_coords.clear();
+  m_weights.clear();
+}
+
+
+
+// === IN-BATCH PRE-AGGREGATION ===
+
+// Inserts batches of data points into a histogram by first summing up their
+// weights per bin in private storage, then updating each touched bin once
+//
+// When a batch has many more data points than the histogram has bins, FillN
+// updates the same bins over and over, and each update must wait for the
+// previous one to reach the store buffer. Aggregating the batch beforehand
+// turns this into one update per touched bin. Splitting aggregation (which
+// does not touch the histogram) from the commit also lets concurrent fillers
+// do most of the work outside of the histogram's lock, as done by
+// AggregatingConcurrentFillManager below.
+//
+// Histograms with up to MAX_DENSE_BINS bins are aggregated in a dense table
+// indexed by bin. Larger ones are aggregated by sorting the batch's bin
+// indices, so that memory usage stays proportional to the batch size.
+//
+// Batches of less than "threshold" data points are not worth aggregating,
+// and FillN inserts them into the histogram directly.
+//
+// HIST should only record bin contents and bin uncertainties, and must not
+// have growable axes.
+//
+template <class HIST>
+class BatchAggregator
+{
+public:
+  using CoordArray_t = typename HIST::CoordArray_t;
+  using Weight_t = typename HIST::Weight_t;
+
+  // Default batch size below which FillN does not aggregate
+  static constexpr size_t DEFAULT_THRESHOLD = 256;
+
+  // Largest histogram which gets a dense aggregation table
+  static constexpr int MAX_DENSE_BINS = 64 * 1024;
+
+  // Set up batch aggregation for some histogram, which must outlive us
+  explicit BatchAggregator(HIST& hist, size_t threshold = DEFAULT_THRESHOLD);
+
+  // Insert a batch of data points into the histogram, with or without
+  // weights (in which case they are assumed to be 1)
+  void FillN(const std::span<const CoordArray_t> xN,
+             const std::span<const Weight_t> weightN);
+  void FillN(const std::span<const CoordArray_t> xN);
+
+  // Two-step version of FillN, where aggregate() only reads the histogram's
+  // axes, and commit() inserts the last aggregated batch into its bins. The
+  // cost of commit() scales with the number of touched bins, not with the
+  // number of data points, which are added to the entry count in O(1).
+  void aggregate(const std::span<const CoordArray_t> xN,
+                 const std::span<const Weight_t> weightN);
+  void aggregate(const std::span<const CoordArray_t> xN);
+  void commit();
+
+  // Batch size from which FillN aggregates data points
+  size_t threshold() const { return m_threshold; }
+
+private:
+  // Aggregate a batch, querying the weight of point i via get_weight(i)
+  template <typename GetWeight>
+  void aggregate_impl(const std::span<const CoordArray_t> xN,
+                      GetWeight&& get_weight);
+
+  // Position of a bin in the dense aggregation table
+  size_t dense_index(int bin) const {
+    return (bin > 0) ? (bin - 1) : (m_num_regular_bins - bin - 1);
+  }
+
+  // Sums of weights and squared weights for one bin
+  struct AggregatedBin
+  {
+    int bin;
+    Weight_t sum_w;
+    Weight_t sum_w2;
+  };
+
+  HIST& m_hist;
+  size_t m_threshold;
+  int m_num_regular_bins;
+  bool m_dense;
+
+  // Dense aggregation table, and whether each bin was touched by the batch
+  std::vector<Weight_t> m_sum_w;
+  std::vector<Weight_t> m_sum_w2;
+  std::vector<char> m_touched;
+
+  // Output of aggregation, used as sort buffer for large histograms
+  std::vector<AggregatedBin> m_aggregated;
+  int64_t m_entries = 0;
+};
+
+
+template <class HIST>
+BatchAggregator<HIST>::BatchAggregator(HIST& hist, size_t threshold)
+  : m_hist(hist)
+  , m_threshold(threshold)
+{
+  const auto& stat = hist.GetImpl()->GetStat();
+  m_num_regular_bins = stat.sizeNoOver();
+  const int num_bins = m_num_regular_bins + stat.sizeUnderOver();
+  m_dense = (num_bins <= MAX_DENSE_BINS);
+  if (m_dense) {
+    m_sum_w.resize(num_bins);
+    m_sum_w2.resize(num_bins);
+    m_touched.resize(num_bins);
+  }
+}
+
+
+template <class HIST>
+void BatchAggregator<HIST>::FillN(const std::span<const CoordArray_t> xN,
+                                  const std::span<const Weight_t> weightN)
+{
+  if (xN.size() < m_threshold) {
+    m_hist.FillN(xN, weightN);
+    return;
+  }
+  aggregate(xN, weightN);
+  commit();
+}
+
+
+template <class HIST>
+void BatchAggregator<HIST>::FillN(const std::span<const CoordArray_t> xN)
+{
+  if (xN.size() < m_threshold) {
+    m_hist.FillN(xN);
+    return;
+  }
+  aggregate(xN);
+  commit();
+}
+
+
+template <class HIST>
+void BatchAggregator<HIST>::aggregate(const std::span<const CoordArray_t> xN,
+                                      const std::span<const Weight_t> weightN)
+{
+  if (xN.size() != weightN.size()) {
+    throw std::runtime_error("Not the same number of points and weights");
+  }
+  aggregate_impl(xN, [&](size_t i) { return weightN[i]; });
+}
+
+
+template <class HIST>
+void BatchAggregator<HIST>::aggregate(const std::span<const CoordArray_t> xN)
+{
+  aggregate_impl(xN, [](size_t) { return Weight_t(1); });
+}
+
+
+template <class HIST>
+template <typename GetWeight>
+void BatchAggregator<HIST>::aggregate_impl(
+  const std::span<const CoordArray_t> xN,
+  GetWeight&& get_weight
+) {
+  const auto& impl = *m_hist.GetImpl();
+  m_aggregated.clear();
+  m_entries = xN.size();
+
+  if (m_dense) {
+    // Accumulate into the dense table, then extract the touched bins
+    for (size_t i = 0; i < xN.size(); ++i) {
+      const int bin = impl.GetBinIndex(xN[i]);
+      const size_t index = dense_index(bin);
+      const Weight_t weight = get_weight(i);
+      m_sum_w[index] += weight;
+      m_sum_w2[index] += weight * weight;
+      if (!m_touched[index]) {
+        m_touched[index] = true;
+        m_aggregated.push_back({bin, 0, 0});
+      }
+    }
+    for (auto& aggregated: m_aggregated) {
+      const size_t index = dense_index(aggregated.bin);
+      aggregated.sum_w = m_sum_w[index];
+      aggregated.sum_w2 = m_sum_w2[index];
+      m_sum_w[index] = 0;
+      m_sum_w2[index] = 0;
+      m_touched[index] = false;
+    }
+  } else {
+    // Sort the batch by bin index, then merge runs of identical bins
+    m_aggregated.reserve(xN.size());
+    for (size_t i = 0; i < xN.size(); ++i) {
+      const Weight_t weight = get_weight(i);
+      m_aggregated.push_back({impl.GetBinIndex(xN[i]), weight,
+                              weight * weight});
+    }
+    std::sort(m_aggregated.begin(), m_aggregated.end(),
+              [](const AggregatedBin& a, const AggregatedBin& b) {
+                return a.bin < b.bin;
+              });
+    size_t num_unique = 0;
+    for (size_t i = 0; i < m_aggregated.size(); ++i) {
+      if ((num_unique > 0)
+          && (m_aggregated[num_unique-1].bin == m_aggregated[i].bin)) {
+        m_aggregated[num_unique-1].sum_w += m_aggregated[i].sum_w;
+        m_aggregated[num_unique-1].sum_w2 += m_aggregated[i].sum_w2;
+      } else {
+        m_aggregated[num_unique++] = m_aggregated[i];
+      }
+    }
+    m_aggregated.resize(num_unique);
+  }
+}
+
+
+template <class HIST>
+void BatchAggregator<HIST>::commit()
+{
+  auto& stat = m_hist.GetImpl()->GetStat();
+  using Stat = std::remove_reference_t<decltype(stat)>;
+  for (const auto& aggregated: m_aggregated) {
+    stat.GetBinContent(aggregated.bin) += aggregated.sum_w;
+    if constexpr (Stat::HasBinUncertainty()) {
+      stat.GetSumOfSquaredWeights(aggregated.bin) += aggregated.sum_w2;
+    }
+  }
+  add_entries(stat, m_entries);
+  m_aggregated.clear();
+  m_entries = 0;
+}
+
+
+// Variant of RHistConcurrentFillManager which pre-aggregates each filler's
+// buffer with a BatchAggregator before taking the histogram's mutex
+//
+// Only the commit of aggregated bins (and of the buffer's entry count, which
+// is O(1)) is done with the mutex held, which shortens flushes when the
+// buffer is large with respect to the number of bins. Buffers smaller than
+// the aggregator's threshold are inserted with FillN, as usual.
+//
+// HIST should only record bin contents and bin uncertainties, and must not
+// have growable axes.
+//
+template <class HIST>
+class AggregatingConcurrentFillManager
+{
+public:
+  using CoordArray_t = typename HIST::CoordArray_t;
+  using Weight_t = typename HIST::Weight_t;
+
+  // Set up a manager for some histogram, which must outlive it, with a
+  // certain filler buffer size (in data points) and aggregation threshold
+  explicit AggregatingConcurrentFillManager(
+    HIST& hist,
+    size_t buffer_size = 1024,
+    size_t threshold = BatchAggregator<HIST>::DEFAULT_THRESHOLD
+  )
+    : m_hist(hist)
+    , m_buffer_size(std::max(buffer_size, size_t(1)))
+    , m_threshold(threshold)
+  {}
+
+  // Per-thread filling interface
+  class Filler
+  {
+  public:
+    explicit Filler(AggregatingConcurrentFillManager& manager)
+      : m_manager(manager)
+      , m_aggregator(manager.m_hist, manager.m_threshold)
+    {
+      m_coords.reserve(manager.m_buffer_size);
+      m_weights.reserve(manager.m_buffer_size);
+    }
+
+    Filler(const Filler&) = delete;
+    Filler& operator=(const Filler&) = delete;
+
+    ~Filler() { Flush(); }
+
+    // Buffer a data point, flushing the buffer if it is full
+    void Fill(const CoordArray_t& x, Weight_t weight = 1.) {
+      m_coords.push_back(x);
+      m_weights.push_back(weight);
+      if (m_coords.size() == m_manager.m_buffer_size) Flush();
+    }
+
+    // Insert the buffered data points into the histogram
+    void Flush();
+
+  private:
+    AggregatingConcurrentFillManager& m_manager;
+    BatchAggregator<HIST> m_aggregator;
+    std::vector<CoordArray_t> m_coords;
+    std::vector<Weight_t> m_weights;
+  };
+
+  // Create a filler for the current thread
+  Filler MakeFiller() { return Filler{*this}; }
+
+private:
+  HIST& m_hist;
+  std::mutex m_hist_mutex;
+  size_t m_buffer_size;
+  size_t m_threshold;
+};
+
+
+template <class HIST>
+void AggregatingConcurrentFillManager<HIST>::Filler::Flush()
+{
+  if (m_coords.empty()) return;
+  if (m_coords.size() < m_aggregator.threshold()) {
+    std::lock_guard<std::mutex> lock{m_manager.m_hist_mutex};
+    m_manager.m_hist.FillN(m_coords, m_weights);
+  } else {
+    m_aggregator.aggregate(m_coords, m_weights);
+    std::lock_guard<std::mutex> lock{m_manager.m_hist_mutex};
+    m_aggregator.commit();
+  }
+  m_coords.clear();
+  m_weights.clear();
+}
+
+
+// === COLUMNAR INPUT ===
+
+// Coordinates of a batch of data points, stored as one contiguous column per
+// axis (structure of arrays) rather than one RCoordArray per data point
+template <int DIMS>
+using CoordColumns = std::array<std::span<const double>, DIMS>;
+
+
+namespace detail
+{
+  // Check that all columns of a batch (and its weights, if any) have the same
+  // length, and return that length
+  template <int DIMS>
+  size_t checked_num_points(const CoordColumns<DIMS>& columns) {
+    const size_t num_points = columns[0].size();
+    for (const auto& column: columns) {
+      if (column.size() != num_points) {
+        throw std::runtime_error("Coordinate columns have different lengths");
+      }
+    }
+    return num_points;
+  }
+  //
+  template <int DIMS, typename Weight>
+  size_t checked_num_points(const CoordColumns<DIMS>& columns,
+                            const std::span<const Weight> weightN) {
+    const size_t num_points = checked_num_points<DIMS>(columns);
+    if (weightN.size() != num_points) {
+      throw std::runtime_error("Not the same number of points and weights");
+    }
+    return num_points;
+  }
+
+  // Fill a histogram from columns, querying the weight of point i via
+  // get_weight(i)
+  template <class HIST, typename GetWeight>
+  void fill_columns_impl(HIST& hist,
+                         const CoordColumns<HIST::GetNDim()>& columns,
+                         size_t num_points,
+                         GetWeight&& get_weight) {
+    auto& impl = *hist.GetImpl();
+    auto& stat = impl.GetStat();
+    typename HIST::CoordArray_t x;
+    for (size_t i = 0; i < num_points; ++i) {
+      for (int axis = 0; axis < HIST::GetNDim(); ++axis) {
+        x[axis] = columns[axis][i];
+      }
+      stat.Fill(x, impl.GetBinIndex(x), get_weight(i));
+    }
+  }
+}
+
+
+// Equivalent of RHist::FillN for columnar input, which reads the coordinates
+// of each data point straight from the columns instead of requiring them to
+// be repacked into a vector of RCoordArray first
+//
+// HIST must not have growable axes.
+//
+template <class HIST>
+void fill_columns(HIST& hist,
+                  const CoordColumns<HIST::GetNDim()>& columns,
+                  const std::span<const typename HIST::Weight_t> weightN) {
+  const size_t num_points =
+    detail::checked_num_points<HIST::GetNDim()>(columns, weightN);
+  detail::fill_columns_impl(hist, columns, num_points,
+                            [&](size_t i) { return weightN[i]; });
+}
+//
+template <class HIST>
+void fill_columns(HIST& hist, const CoordColumns<HIST::GetNDim()>& columns) {
+  using Weight_t = typename HIST::Weight_t;
+  const size_t num_points =
+    detail::checked_num_points<HIST::GetNDim()>(columns);
+  detail::fill_columns_impl(hist, columns, num_points,
+                            [](size_t) { return Weight_t(1); });
+}
+
+// === VECTORIZED FILLN FOR EQUIDISTANT AXES ===
+
+namespace detail
+{
+  // Bin lookup parameters of a histogram's equidistant axes
+  template <int DIMS>
+  struct EquidistantAxes
+  {
+    // Lower bound and inverse bin width of each axis
+    std::array<double, DIMS> minimum;
+    std::array<double, DIMS> inv_bin_width;
+
+    // Local index of each axis' overflow bin, i.e. its number of regular
+    // bins + 1, as a double (local bins are numbered like in ROOT 6, with the
+    // underflow bin at 0)
+    std::array<double, DIMS> overflow_bin;
+
+    // Linear bin index increment associated with each axis' local bin index
+    std::array<int, DIMS> strides;
+  };
+
+  // Compute the linear bin index of "count" points, given as a pointer to the
+  // first coordinate of each axis and a stride (in doubles) between points
+  //
+  // The local bin of a coordinate x on an axis is computed as
+  // (x - minimum) * inv_bin_width + 1, clamped to the under- and overflow
+  // bins and truncated, which is what RAxisEquidistant::FindBin does. This
+  // is done for a vector of points at a time with AVX-512 or AVX2, if
+  // enabled at compile time (e.g. with -march=native).
+  //
+  template <int DIMS>
+  void find_equidistant_bins(const EquidistantAxes<DIMS>& axes,
+                             const std::array<const double*, DIMS>& coords,
+                             int stride,
+                             size_t count,
+                             int* bins)
+  {
+    size_t i = 0;
+#if defined(__AVX512F__)
+    const __m256i gather_idx = _mm256_mullo_epi32(
+      _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+      _mm256_set1_epi32(stride)
+    );
+    for (; i + 8 <= count; i += 8) {
+      __m256i linear = _mm256_setzero_si256();
+      for (int axis = 0; axis < DIMS; ++axis) {
+        const double* const x_ptr = coords[axis] + i * stride;
+        const __m512d x = (stride == 1)
+                          ? _mm512_loadu_pd(x_ptr)
+                          : _mm512_i32gather_pd(gather_idx, x_ptr, 8);
+        __m512d t = _mm512_mul_pd(
+          _mm512_sub_pd(x, _mm512_set1_pd(axes.minimum[axis])),
+          _mm512_set1_pd(axes.inv_bin_width[axis])
+        );
+        t = _mm512_add_pd(t, _mm512_set1_pd(1.));
+        t = _mm512_max_pd(t, _mm512_setzero_pd());
+        t = _mm512_min_pd(t, _mm512_set1_pd(axes.overflow_bin[axis]));
+        const __m256i local = _mm512_cvttpd_epi32(t);
+        linear = _mm256_add_epi32(
+          linear,
+          _mm256_mullo_epi32(local, _mm256_set1_epi32(axes.strides[axis]))
+        );
+      }
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(bins + i), linear);
+    }
+#elif defined(__AVX2__)
+    const __m128i gather_idx = _mm_mullo_epi32(_mm_setr_epi32(0, 1, 2, 3),
+                                               _mm_set1_epi32(stride));
+    for (; i + 4 <= count; i += 4) {
+      __m128i linear = _mm_setzero_si128();
+      for (int axis = 0; axis < DIMS; ++axis) {
+        const double* const x_ptr = coords[axis] + i * stride;
+        const __m256d x = (stride == 1)
+                          ? _mm256_loadu_pd(x_ptr)
+                          : _mm256_i32gather_pd(x_ptr, gather_idx, 8);
+        __m256d t = _mm256_mul_pd(
+          _mm256_sub_pd(x, _mm256_set1_pd(axes.minimum[axis])),
+          _mm256_set1_pd(axes.inv_bin_width[axis])
+        );
+        t = _mm256_add_pd(t, _mm256_set1_pd(1.));
+        t = _mm256_max_pd(t, _mm256_setzero_pd());
+        t = _mm256_min_pd(t, _mm256_set1_pd(axes.overflow_bin[axis]));
+        const __m128i local = _mm256_cvttpd_epi32(t);
+        linear = _mm_add_epi32(
+          linear,
+          _mm_mullo_epi32(local, _mm_set1_epi32(axes.strides[axis]))
+        );
+      }
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(bins + i), linear);
+    }
+#endif
+
+    // Scalar fallback, written to mimic the SIMD max/min semantics
+    for (; i < count; ++i) {
+      int linear = 0;
+      for (int axis = 0; axis < DIMS; ++axis) {
+        const double x = coords[axis][i * stride];
+        double t = (x - axes.minimum[axis]) * axes.inv_bin_width[axis];
+        t += 1.;
+        t = (t > 0.) ? t : 0.;
+        t = (t < axes.overflow_bin[axis]) ? t : axes.overflow_bin[axis];
+        linear += int(t) * axes.strides[axis];
+      }
+      bins[i] = linear;
+    }
+  }
+}
+
+
+// FillN for histograms with 1 to 3 equidistant axes, which computes the bin
+// indices of a batch of points with SIMD instructions then updates the bins
+// in a tight loop, bypassing RHist's per-point virtual axis lookups
+//
+// Bins are updated through RHistData::Fill, so all statistics recorded by
+// HIST are kept up to date. The mapping from local bin indices to ROOT 7
+// global bin indices is tabulated at construction time, so this is not meant
+// for histograms with a huge number of bins.
+//
+template <class HIST>
+class EquidistantBatchFill
+{
+public:
+  static constexpr int DIMS = HIST::GetNDim();
+  using CoordArray_t = typename HIST::CoordArray_t;
+  using Weight_t = typename HIST::Weight_t;
+
+  static_assert((DIMS >= 1) && (DIMS <= 3),
+                "EquidistantBatchFill supports 1D to 3D histograms");
+  static_assert(sizeof(CoordArray_t) == DIMS * sizeof(double),
+                "Coordinates of consecutive points should be contiguous");
+
+  // Set up vectorized filling of some histogram, which must outlive us.
+  // Throws std::runtime_error if an axis is not equidistant or can grow.
+  explicit EquidistantBatchFill(HIST& hist);
+
+  // Insert a batch of data points into the histogram, with or without
+  // weights (in which case they are assumed to be 1)
+  void FillN(const std::span<const CoordArray_t> xN,
+             const std::span<const Weight_t> weightN);
+  void FillN(const std::span<const CoordArray_t> xN);
+
+  // Same for columnar input, which lets SIMD code load coordinates directly
+  // instead of gathering them from an array of RCoordArray
+  void FillN(const CoordColumns<DIMS>& columns,
+             const std::span<const Weight_t> weightN);
+  void FillN(const CoordColumns<DIMS>& columns);
+
+private:
+  // Number of points whose bin index is computed before updating bins
+  static constexpr size_t BLOCK_SIZE = 256;
+
+  // Fill the histogram with "count" points, whose coordinates along each
+  // axis start at coords[axis] and are "stride" doubles apart, querying the
+  // weight of point i via get_weight(i)
+  template <typename GetWeight>
+  void fill_blocks(std::array<const double*, DIMS> coords,
+                   int stride,
+                   size_t count,
+                   GetWeight&& get_weight);
+
+  HIST& m_hist;
+  detail::EquidistantAxes<DIMS> m_axes;
+
+  // ROOT 7 global bin index associated with each linear bin index
+  std::vector<int> m_bin_table;
+};
+
+
+template <class HIST>
+EquidistantBatchFill<HIST>::EquidistantBatchFill(HIST& hist)
+  : m_hist(hist)
+{
+  const auto& impl = *hist.GetImpl();
+
+  // Record the axis configuration
+  int stride = 1;
+  for (int axis = 0; axis < DIMS; ++axis) {
+    const auto* const eq_axis_ptr =
+      dynamic_cast<const ROOT::Experimental::RAxisEquidistant*>(
+        &impl.GetAxis(axis)
+      );
+    if ((eq_axis_ptr == nullptr) || eq_axis_ptr->CanGrow()) {
+      throw std::runtime_error("EquidistantBatchFill only supports "
+                               "non-growable equidistant axes");
+    }
+    const int num_bins = eq_axis_ptr->GetNBinsNoOver();
+    m_axes.minimum[axis] = eq_axis_ptr->GetMinimum();
+    m_axes.inv_bin_width[axis] = eq_axis_ptr->GetInverseBinWidth();
+    m_axes.overflow_bin[axis] = num_bins + 1;
+    m_axes.strides[axis] = stride;
+    stride *= num_bins + 2;
+  }
+
+  // Tabulate the ROOT 7 global bin index of every local bin combination
+  m_bin_table.resize(stride);
+  auto record_bin = [&](int bin) {
+    const auto local = impl.GetLocalBins(bin);
+    int linear = 0;
+    for (int axis = 0; axis < DIMS; ++axis) {
+      int local_bin = local[axis];
+      if (local_bin == -1) {
+        local_bin = 0;
+      } else if (local_bin == -2) {
+        local_bin = int(m_axes.overflow_bin[axis]);
+      }
+      linear += local_bin * m_axes.strides[axis];
+    }
+    m_bin_table[linear] = bin;
+  };
+  const auto& stat = impl.GetStat();
+  const int num_regular_bins = stat.sizeNoOver();
+  const int num_overflow_bins = stat.sizeUnderOver();
+  for (int bin = 1; bin <= num_regular_bins; ++bin) record_bin(bin);
+  for (int bin = -1; bin >= -num_overflow_bins; --bin) record_bin(bin);
+}
+
+
+template <class HIST>
+void EquidistantBatchFill<HIST>::FillN(
+  const std::span<const CoordArray_t> xN,
+  const std::span<const Weight_t> weightN
+) {
+  if (xN.size() != weightN.size()) {
+    throw std::runtime_error("Not the same number of points and weights");
+  }
+  if (xN.empty()) return;
+  std::array<const double*, DIMS> coords;
+  for (int axis = 0; axis < DIMS; ++axis) coords[axis] = &xN[0][axis];
+  fill_blocks(coords, DIMS, xN.size(), [&](size_t i) { return weightN[i]; });
+}
+
+
+template <class HIST>
+void EquidistantBatchFill<HIST>::FillN(
+  const std::span<const CoordArray_t> xN
+) {
+  if (xN.empty()) return;
+  std::array<const double*, DIMS> coords;
+  for (int axis = 0; axis < DIMS; ++axis) coords[axis] = &xN[0][axis];
+  fill_blocks(coords, DIMS, xN.size(), [](size_t) { return Weight_t(1); });
+}
+
+
+template <class HIST>
+void EquidistantBatchFill<HIST>::FillN(
+  const CoordColumns<DIMS>& columns,
+  const std::span<const Weight_t> weightN
+) {
+  const size_t num_points =
+    detail::checked_num_points<DIMS>(columns, weightN);
+  std::array<const double*, DIMS> coords;
+  for (int axis = 0; axis < DIMS; ++axis) coords[axis] = columns[axis].data();
+  fill_blocks(coords, 1, num_points, [&](size_t i) { return weightN[i]; });
+}
+
+
+template <class HIST>
+void EquidistantBatchFill<HIST>::FillN(const CoordColumns<DIMS>& columns) {
+  const size_t num_points = detail::checked_num_points<DIMS>(columns);
+  std::array<const double*, DIMS> coords;
+  for (int axis = 0; axis < DIMS; ++axis) coords[axis] = columns[axis].data();
+  fill_blocks(coords, 1, num_points, [](size_t) { return Weight_t(1); });
+}
+
+
+template <class HIST>
+template <typename GetWeight>
+void EquidistantBatchFill<HIST>::fill_blocks(
+  std::array<const double*, DIMS> coords,
+  int stride,
+  size_t count,
+  GetWeight&& get_weight
+) {
+  auto& stat = m_hist.GetImpl()->GetStat();
+  std::array<int, BLOCK_SIZE> bins;
+  CoordArray_t x;
+  for (size_t start = 0; start < count; start += BLOCK_SIZE) {
+    const size_t block_size = std::min(BLOCK_SIZE, count - start);
+    detail::find_equidistant_bins<DIMS>(m_axes, coords, stride, block_size,
+                                        bins.data());
+    for (size_t i = 0; i < block_size; ++i) {
+      for (int axis = 0; axis < DIMS; ++axis) {
+        x[axis] = coords[axis][i * stride];
+      }
+      stat.Fill(x, m_bin_table[bins[i]], get_weight(start + i));
+    }
+    for (auto& axis_coords: coords) axis_coords += block_size * stride;
+  }
+}
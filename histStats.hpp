@@ -0,0 +1,97 @@
+// Workarounds for the limited ROOT 7 histogram statistics API
+
+#pragma once
+
+#include "ROOT/RHistData.hxx"
+
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+
+namespace detail
+{
+  // Access the entry count of some ROOT 7 histogram statistics
+  //
+  // FIXME: As of ROOT 6.18.0, RHistStatContent does not provide a way to
+  //        set its entry count, which is only ever incremented by Fill().
+  //        Going there with zero-weight fills costs O(num_entries), which is
+  //        way too much for something that histogram conversions and fill
+  //        managers must do on every call. So we use the fact that the entry
+  //        count is the first data member of RHistStatContent, which has a
+  //        standard layout and is thus pointer-interconvertible with it.
+  //        Callers check that this assumption holds, see add_entries.
+  //
+  template <int DIMENSIONS, class PRECISION>
+  int64_t&
+  entry_count(ROOT::Experimental::RHistStatContent<DIMENSIONS,
+                                                    PRECISION>& content) {
+    using Content =
+      ROOT::Experimental::RHistStatContent<DIMENSIONS, PRECISION>;
+    static_assert(std::is_standard_layout_v<Content>,
+                  "Cannot locate the entry count of RHistStatContent");
+    static_assert(
+      std::is_same_v<decltype(content.GetEntries()), int64_t>,
+      "Unexpected RHistStatContent entry count type"
+    );
+    return *reinterpret_cast<int64_t*>(&content);
+  }
+}
+
+
+// Add "num_entries" to the entry count of some ROOT 7 histogram statistics
+// (RHistData or its RHistStatContent component), leaving bin contents
+// unchanged. This is O(1), see detail::entry_count for the hack behind it.
+template <class Stat>
+void add_entries(Stat& stat, int64_t num_entries) {
+  if (num_entries == 0) return;
+  const int64_t old_entries = stat.GetEntries();
+  int64_t& entries = detail::entry_count(stat);
+  if (entries != old_entries) {
+    throw std::runtime_error("Unexpected RHistStatContent layout");
+  }
+  entries += num_entries;
+  if (stat.GetEntries() != old_entries + num_entries) {
+    entries = old_entries;
+    throw std::runtime_error("Unexpected RHistStatContent layout");
+  }
+}
+
+
+// Add the bin contents (and sums of squared weights, if recorded) of some
+// ROOT 7 histogram statistics to those of other statistics with the same bin
+// layout. Entry counts are left alone, see add_entries for that.
+template <class Stat>
+void add_bin_data(Stat& to, const Stat& from) {
+  auto add_bin = [&](int bin) {
+    to.GetBinContent(bin) += from.GetBinContent(bin);
+    if constexpr (Stat::HasBinUncertainty()) {
+      to.GetSumOfSquaredWeights(bin) += from.GetSumOfSquaredWeights(bin);
+    }
+  };
+  const int num_regular_bins = from.sizeNoOver();
+  const int num_overflow_bins = from.sizeUnderOver();
+  for (int bin = 1; bin <= num_regular_bins; ++bin) add_bin(bin);
+  for (int bin = -1; bin >= -num_overflow_bins; --bin) add_bin(bin);
+}
+
+
+// Reset the bin contents (and sums of squared weights, if recorded) of some
+// ROOT 7 histogram statistics to zero.
+//
+// Entry counts are left alone, so callers must keep track of them separately
+// (or rewind them with add_entries).
+//
+template <class Stat>
+void clear_bin_data(Stat& stat) {
+  auto clear_bin = [&](int bin) {
+    stat.GetBinContent(bin) = 0;
+    if constexpr (Stat::HasBinUncertainty()) {
+      stat.GetSumOfSquaredWeights(bin) = 0;
+    }
+  };
+  const int num_regular_bins = stat.sizeNoOver();
+  const int num_overflow_bins = stat.sizeUnderOver();
+  for (int bin = 1; bin <= num_regular_bins; ++bin) clear_bin(bin);
+  for (int bin = -1; bin >= -num_overflow_bins; --bin) clear_bin(bin);
+}
@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+"""Plot the thread scaling results of fillBench
+
+fillBench records how parallel filling strategies scale with the number of
+threads in fillBench_scaling.csv. This script turns that file into one plot
+per thread placement, titled with the host on which measurements were taken.
+
+Usage: ./plotFillBench.py [fillBench_scaling.csv] [FillBenchScaling.png]
+"""
+
+import csv
+import sys
+from collections import defaultdict
+
+import matplotlib
+matplotlib.use("Agg")
+import matplotlib.pyplot as plt
+
+
+def main():
+    csv_path = sys.argv[1] if len(sys.argv) > 1 else "fillBench_scaling.csv"
+    png_path = sys.argv[2] if len(sys.argv) > 2 else "FillBenchScaling.png"
+
+    # Load the results, grouped by placement then strategy
+    host = None
+    results = defaultdict(lambda: defaultdict(list))
+    with open(csv_path, newline="") as csv_file:
+        for row in csv.DictReader(csv_file):
+            host = (row["cpu_model"], row["kernel"], row["compiler"],
+                    "ROOT " + row["root_version"])
+            results[row["placement"]][row["strategy"]].append(
+                (int(row["threads"]), float(row["ns_per_iter"]))
+            )
+    if host is None:
+        sys.exit("No results in " + csv_path)
+
+    # One plot per placement, with one curve per strategy
+    placements = list(results)
+    fig, axes = plt.subplots(1, len(placements), squeeze=False, sharey=True,
+                             figsize=(6 * len(placements), 5))
+    for ax, placement in zip(axes[0], placements):
+        for strategy, points in sorted(results[placement].items()):
+            points.sort()
+            ax.plot([threads for threads, _ in points],
+                    [ns_per_iter for _, ns_per_iter in points],
+                    marker="o", label=strategy)
+        ax.set_title(placement + " threads")
+        ax.set_xscale("log", base=2)
+        ax.set_yscale("log")
+        ax.set_xlabel("Threads")
+        ax.grid(True, which="both", alpha=0.3)
+    axes[0][0].set_ylabel("Time per Fill (ns)")
+    axes[0][-1].legend(fontsize="small")
+    fig.suptitle(" / ".join(host), fontsize="small")
+    fig.tight_layout()
+    fig.savefig(png_path)
+
+
+if __name__ == "__main__":
+    main()